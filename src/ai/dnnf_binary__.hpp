@@ -0,0 +1,259 @@
+// -----------------------------------------------------------------------------
+// Online Combinatorial Optimization
+// dnnf_binary__.hpp
+// -----------------------------------------------------------------------------
+
+#ifndef DNNF_BINARY__HPP
+#define DNNF_BINARY__HPP
+
+// -----------------------------------------------------------------------------
+// Binary circuit format
+// A frozen circuit is stored as a header followed by word-aligned sections:
+//   nodes[n_nodes]                 Node records
+//   child_offsets[n_nodes + 1]     out-edge CSR
+//   child_indices[n_edges]
+//   parent_offsets[n_nodes + 1]    in-edge CSR
+//   parent_indices[n_edges]
+//   label_offsets[n_edges + 1]     gap variables by out-edge
+//   label_indices[n_labels]
+// Loading maps the file copy-on-write, so that arrays are used in place and
+// processes loading the same file share one page-cache copy, while a write
+// through the circuit's arrays only copies the page it touches. The arrays
+// are validated before use: offsets ascend to the size of their section,
+// children precede their parents, and variables are in range. The literal
+// occurrence and level indexes are not stored; they are rebuilt after mapping.
+// Node records are written field by field over zeroed memory, so that the
+// padding bytes (hence the files) are deterministic.
+// -----------------------------------------------------------------------------
+
+const char bin_magic[8] = {'O', 'C', 'O', 'D', 'N', 'N', 'F', '\0'};
+const uword bin_version = 1;
+
+struct BinHeader
+{
+	char magic[8];
+	uword version;
+	uword word_size;
+	uword node_size;
+	uword n_nodes;
+	uword n_variables;
+	uword n_edges;
+	uword n_labels;
+};
+
+static_assert(std::is_trivially_copyable<Node>::value, "Node records must be trivially copyable");
+
+inline uword bin_file_size(const BinHeader& header)
+{
+	return sizeof(BinHeader)
+	       + (header.n_nodes * sizeof(Node))
+	       + (2 * (header.n_nodes + 1) * sizeof(uword))
+	       + (2 * header.n_edges * sizeof(uword))
+	       + ((header.n_edges + 1) * sizeof(uword))
+	       + (header.n_labels * sizeof(uword));
+}
+
+// Armadillo only borrows memory at construction time (the mapping is private
+// and writable, see load_bin_file)
+inline void bin_view(uvec& v, const char*& position, const uword n)
+{
+	uword* memory = reinterpret_cast<uword*>(const_cast<char*>(position));
+	v.~uvec();
+	new (&v) uvec(memory, n, false, true);
+	position += n * sizeof(uword);
+}
+
+inline void bin_write(std::ofstream& file, const uvec& v)
+{
+	file.write(reinterpret_cast<const char*>(v.memptr()), v.n_elem * sizeof(uword));
+}
+
+inline void bin_write(std::ofstream& file, const Node* nodes, const uword n_nodes)
+{
+	Array<char> records(n_nodes * sizeof(Node), 0);
+	for(uword index = 0; index < n_nodes; ++index)
+	{
+		char* record = records.data() + (index * sizeof(Node));
+		std::memcpy(record + offsetof(Node, sgn), &nodes[index].sgn, sizeof(Node::sgn));
+		std::memcpy(record + offsetof(Node, type), &nodes[index].type, sizeof(Node::type));
+		std::memcpy(record + offsetof(Node, var), &nodes[index].var, sizeof(Node::var));
+	}
+	file.write(records.data(), records.size());
+}
+
+// Offsets start at 0, never decrease, and end at the size of their section
+inline bool bin_check_offsets(const uvec& offsets, const uword n_items)
+{
+	if(offsets[0] != 0 || offsets[offsets.n_elem - 1] != n_items)
+		return false;
+	for(uword i = 0; i + 1 < offsets.n_elem; ++i)
+		if(offsets[i] > offsets[i + 1])
+			return false;
+	return true;
+}
+
+inline bool bin_check_arrays(const BinHeader& header, const Node* nodes,
+                             const uvec& child_offsets, const uvec& child_indices,
+                             const uvec& parent_offsets, const uvec& parent_indices,
+                             const uvec& label_offsets, const uvec& label_indices)
+{
+	if(!bin_check_offsets(child_offsets, header.n_edges)
+	   || !bin_check_offsets(parent_offsets, header.n_edges)
+	   || !bin_check_offsets(label_offsets, header.n_labels))
+		return false;
+
+	for(uword index = 0; index < header.n_nodes; ++index)
+	{
+		switch(nodes[index].type)
+		{
+		case 'a':
+		case 'd':
+		case 'f':
+		case 'o':
+		case 't':
+			break;
+
+		case 'l':
+			if(nodes[index].var >= header.n_variables)
+				return false;
+			break;
+
+		default:
+			return false;
+		}
+
+		for(uword e = child_offsets[index]; e < child_offsets[index + 1]; ++e)
+			if(child_indices[e] >= index)
+				return false;
+		for(uword e = parent_offsets[index]; e < parent_offsets[index + 1]; ++e)
+			if(parent_indices[e] <= index || parent_indices[e] >= header.n_nodes)
+				return false;
+	}
+
+	for(uword i = 0; i < header.n_labels; ++i)
+		if(label_indices[i] >= header.n_variables)
+			return false;
+	return true;
+}
+
+inline bool is_bin_file(const std::string& dataset_name)
+{
+	std::ifstream file("./dat/" + dataset_name, std::ios::binary);
+	char magic[sizeof(bin_magic)];
+	if(!file.read(magic, sizeof(magic)))
+		return false;
+	return std::equal(magic, magic + sizeof(magic), bin_magic);
+}
+
+template<circuit_t C>
+bool save_bin_file(const Circuit<C>& circuit, const std::string& dataset_name)
+{
+	cout << io::info("saving file") << dataset_name << endl;
+
+	std::string filename = "./dat/" + dataset_name;
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	if(!file)
+	{
+		cerr << io::error("cannot open " + filename) << endl;
+		return 0;
+	}
+
+	const Circuit<NNF>& source = circuit;
+	BinHeader header;
+	std::copy(bin_magic, bin_magic + sizeof(bin_magic), header.magic);
+	header.version = bin_version;
+	header.word_size = sizeof(uword);
+	header.node_size = sizeof(Node);
+	header.n_nodes = circuit.n_nodes();
+	header.n_variables = circuit.n_variables();
+	header.n_edges = circuit.n_edges();
+	header.n_labels = source.label_indices__.n_elem;
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	bin_write(file, source.nodes__, circuit.n_nodes());
+	bin_write(file, source.child_offsets__);
+	bin_write(file, source.child_indices__);
+	bin_write(file, source.parent_offsets__);
+	bin_write(file, source.parent_indices__);
+	bin_write(file, source.label_offsets__);
+	bin_write(file, source.label_indices__);
+
+	if(!file)
+	{
+		cerr << io::error("unable to write file " + filename) << endl;
+		return 0;
+	}
+	return 1;
+}
+
+template<circuit_t C>
+bool load_bin_file(Circuit<C>& circuit, const std::string& dataset_name)
+{
+	cout << io::info("mapping file") << dataset_name << endl;
+
+	std::string filename = "./dat/" + dataset_name;
+	auto file = std::make_shared<io::mapped_file>(filename, true);
+	if(!file->is_open())
+	{
+		cerr << io::error("cannot open " + filename) << endl;
+		return 0;
+	}
+
+	if(file->size() < sizeof(BinHeader))
+	{
+		cerr << io::error("truncated header in " + filename) << endl;
+		return 0;
+	}
+
+	const BinHeader& header = *reinterpret_cast<const BinHeader*>(file->begin());
+	if(!std::equal(bin_magic, bin_magic + sizeof(bin_magic), header.magic))
+	{
+		cerr << io::error("bad magic number in " + filename) << endl;
+		return 0;
+	}
+
+	if(header.version != bin_version || header.word_size != sizeof(uword) || header.node_size != sizeof(Node))
+	{
+		cerr << io::error("incompatible binary format in " + filename) << endl;
+		return 0;
+	}
+
+	// Counts beyond the file size would overflow the expected size; every
+	// variable of a smooth circuit takes at least one word (a literal node or
+	// a gap variable) as well
+	const uword n_words = file->size() / sizeof(uword);
+	if(header.n_nodes >= n_words || header.n_edges >= n_words || header.n_labels >= n_words
+	   || header.n_variables >= n_words || file->size() != bin_file_size(header))
+	{
+		cerr << io::error("bad file size in " + filename) << endl;
+		return 0;
+	}
+
+	const char* position = file->begin() + sizeof(BinHeader);
+	circuit = Circuit<C>();
+	Circuit<NNF>& target = circuit;
+	target.nodes__ = reinterpret_cast<const Node*>(position);
+	position += header.n_nodes * sizeof(Node);
+	bin_view(target.child_offsets__, position, header.n_nodes + 1);
+	bin_view(target.child_indices__, position, header.n_edges);
+	bin_view(target.parent_offsets__, position, header.n_nodes + 1);
+	bin_view(target.parent_indices__, position, header.n_edges);
+	bin_view(target.label_offsets__, position, header.n_edges + 1);
+	bin_view(target.label_indices__, position, header.n_labels);
+	target.n_nodes__ = header.n_nodes;
+	target.n_variables__ = header.n_variables;
+	target.mapping__ = file;
+	if(!bin_check_arrays(header, target.nodes__, target.child_offsets__, target.child_indices__,
+	                     target.parent_offsets__, target.parent_indices__,
+	                     target.label_offsets__, target.label_indices__))
+	{
+		cerr << io::error("corrupt circuit arrays in " + filename) << endl;
+		circuit = Circuit<C>();
+		return 0;
+	}
+	target.index_occurrences();
+	target.index_levels();
+	return 1;
+}
+
+#endif
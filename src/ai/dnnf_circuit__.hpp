@@ -8,11 +8,14 @@
 
 #include "nnf_circuit__.hpp"
 #include "dnnf_load__.hpp"
+#include "dnnf_binary__.hpp"
+#include "dnnf_simplify__.hpp"
 
 // -----------------------------------------------------------------------------
 // Class Circuit<DNNF>
 // (deterministic) Decomposable Negation Normal Form circuit
 // Attributes range from 0 to n-1 (minus 1 from .cnf and .nnf formats)
+// Files are either .nnf text files or binary files, detected by magic number
 // -----------------------------------------------------------------------------
 
 template<>
@@ -41,11 +44,29 @@ class Circuit<DNNF>: public Circuit<NNF>
 		inline Circuit(const std::string & filename) :
 			Circuit()
 		{
-			bool is_loaded = load_nnf_file(*this, filename);
+			bool is_loaded = false;
+			if(is_bin_file(filename))
+				is_loaded = load_bin_file(*this, filename);
+			else
+			{
+				is_loaded = load_nnf_file(*this, filename);
+				freeze();
+			}
 			if(!is_loaded) n_variables__ = 0;
 		}
 
+	public:                 // Transformations
+		inline void simplify()
+		{
+			::simplify(*this);
+		}
+
 	public:                 // IO
+		inline bool save(const std::string& filename) const
+		{
+			return save_bin_file(*this, filename);
+		}
+
 		friend ostream & operator <<(ostream & output, const Circuit<DNNF>& circuit)
 		{
 			print(output, circuit);
@@ -36,6 +36,161 @@ class Counter__<DNNF>: public Engine__<DNNF, CT>
 		{
 		}
 
+	protected:              // Literal marginals
+		// One forward and one backward pass; the marginal of a literal l is
+		// w_l * (dZ / dw_l) normalized over the two literals of its variable
+		// (variables that do not occur in the circuit are set to true)
+		inline void marginalize_literals(dvec& marginals,
+		                                 dvec& node_weights,
+		                                 dvec& node_derivatives,
+		                                 dvec& literal_derivatives,
+		                                 const dvec& distribution)
+		{
+			push_weights(node_weights, distribution);
+			pull_derivatives(literal_derivatives, node_derivatives, node_weights, distribution);
+
+			literal_derivatives %= distribution;
+			normalize_literals(marginals, literal_derivatives);
+		}
+
+		inline void marginalize_literals(dvec& marginals,
+		                                 dvec& node_weights,
+		                                 dvec& node_derivatives,
+		                                 dvec& literal_derivatives,
+		                                 const dvec& distribution,
+		                                 traits::ct)
+		{
+			marginalize_literals(marginals, node_weights, node_derivatives, literal_derivatives, distribution);
+		}
+
+		// Same with log-weights; the backward pass directly yields the flows
+		// (w dZ/dw) / Z, so the derivatives are never formed
+		inline void marginalize_literals(dvec& marginals,
+		                                 dvec& node_weights,
+		                                 dvec& node_flows,
+		                                 dvec& literal_flows,
+		                                 const dvec& log_distribution,
+		                                 traits::lct)
+		{
+			push_weights(node_weights, log_distribution, traits::lct());
+			pull_derivatives(literal_flows, node_flows, node_weights, log_distribution, traits::lct());
+			normalize_literals(marginals, literal_flows);
+		}
+
+		inline void normalize_literals(dvec& marginals, const dvec& literal_flows)
+		{
+			marginals.zeros();
+			for(uword x = 0; x < n_variables__; ++x)
+			{
+				double wx = literal_flows[2 * x];
+				double wnx = literal_flows[(2 * x) + 1];
+				if(wx + wnx > 0.0)
+				{
+					marginals[2 * x] = wx / (wx + wnx);
+					marginals[(2 * x) + 1] = wnx / (wx + wnx);
+				}
+				else
+					marginals[2 * x] = 1.0;
+			}
+		}
+
+	protected:              // Exact counting
+		// Node counts are kept as 64-bit integers as long as they fit; a node
+		// whose count overflows is promoted to a GMP integer, stored in a side
+		// table and referenced by its slot (none for 64-bit nodes)
+		inline static mpi exact_value(const uword index,
+		                              const Array<std::uint64_t>& small_counts,
+		                              const uarray& slots,
+		                              const Array<mpi>& big_counts)
+		{
+			if(slots[index] == std::numeric_limits<uword>::max())
+				return mpi(small_counts[index]);
+			return big_counts[slots[index]];
+		}
+
+		inline void count_and_node(Array<std::uint64_t>& small_counts,
+		                           uarray& slots,
+		                           Array<mpi>& big_counts,
+		                           const uword index)
+		{
+			const uword none = std::numeric_limits<uword>::max();
+			std::uint64_t product = 1;
+			bool is_small = true;
+			mpi value;
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				uword child = circuit__.child(e);
+				std::uint64_t result;
+				if(is_small && slots[child] == none && !__builtin_mul_overflow(product, small_counts[child], &result))
+				{
+					product = result;
+					continue;
+				}
+				if(is_small)
+				{
+					value = product;
+					is_small = false;
+				}
+				value *= exact_value(child, small_counts, slots, big_counts);
+			}
+
+			if(is_small)
+				small_counts[index] = product;
+			else
+			{
+				slots[index] = big_counts.size();
+				big_counts.push_back(value);
+			}
+		}
+
+		// The count of an or-edge is the count of its child times 2^|gap|
+		inline void count_or_node(Array<std::uint64_t>& small_counts,
+		                          uarray& slots,
+		                          Array<mpi>& big_counts,
+		                          const uword index)
+		{
+			const uword none = std::numeric_limits<uword>::max();
+			std::uint64_t sum = 0;
+			bool is_small = true;
+			mpi value;
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				uword child = circuit__.child(e);
+				uword gap = circuit__.label_end(e) - circuit__.label_begin(e);
+				if(slots[child] == none && gap < 64 && small_counts[child] <= (UINT64_MAX >> gap))
+				{
+					std::uint64_t term = small_counts[child] << gap;
+					std::uint64_t result;
+					if(is_small && !__builtin_add_overflow(sum, term, &result))
+					{
+						sum = result;
+						continue;
+					}
+					if(is_small)
+					{
+						value = sum;
+						is_small = false;
+					}
+					value += term;
+					continue;
+				}
+				if(is_small)
+				{
+					value = sum;
+					is_small = false;
+				}
+				value += exact_value(child, small_counts, slots, big_counts) << gap;
+			}
+
+			if(is_small)
+				small_counts[index] = sum;
+			else
+			{
+				slots[index] = big_counts.size();
+				big_counts.push_back(value);
+			}
+		}
+
 	public:                 // Public counting operations
 		inline double count()
 		{
@@ -53,6 +208,74 @@ class Counter__<DNNF>: public Engine__<DNNF, CT>
 			return weights[n_nodes__ - 1];
 		}
 
+		// One count per column of distributions, in a single batched traversal
+		inline dvec count(const dmat& distributions)
+		{
+			assert(distributions.n_rows == n_literals__);
+			dmat weights;
+			push_weights(weights, distributions);
+			return weights.row(n_nodes__ - 1).t();
+		}
+
+		// Exact (unweighted) model count; subcircuits whose counts fit in 64
+		// bits never touch the arbitrary precision arithmetic
+		inline mpi count_models()
+		{
+			Array<std::uint64_t> small_counts(n_nodes__, 0);
+			uarray slots(n_nodes__, std::numeric_limits<uword>::max());
+			Array<mpi> big_counts;
+			for(uword index = 0; index < n_nodes__; ++index)
+				switch(circuit__.node_label(index).type)
+				{
+				case 'a':
+					count_and_node(small_counts, slots, big_counts, index);
+					break;
+
+				case 'f':
+					small_counts[index] = 0;
+					break;
+
+				case 'l':
+				case 't':
+					small_counts[index] = 1;
+					break;
+
+				case 'o':
+					count_or_node(small_counts, slots, big_counts, index);
+					break;
+				}
+			return exact_value(n_nodes__ - 1, small_counts, slots, big_counts);
+		}
+
+		// Natural logarithm of an exact count, from its 53 leading bits
+		inline static double log_count(const mpi& count)
+		{
+			if(count <= 0)
+				return -std::numeric_limits<double>::infinity();
+			uword msb = boost::multiprecision::msb(count);
+			uword shift = (msb > 52) ? msb - 52 : 0;
+			mpi head = count >> shift;
+			return std::log(head.convert_to<double>()) + ((double)shift * std::log(2.0));
+		}
+
+		// Log-domain count: the literal weights are given by their logarithms
+		// and the logarithm of the weighted model count is returned
+		inline double count(const dvec& log_distribution, traits::lct)
+		{
+			assert(log_distribution.n_elem == n_literals__);
+			dvec weights(n_nodes__);
+			push_weights(weights, log_distribution, traits::lct());
+			return weights[n_nodes__ - 1];
+		}
+
+		inline dvec count(const dmat& log_distributions, traits::lct)
+		{
+			assert(log_distributions.n_rows == n_literals__);
+			dmat weights;
+			push_weights(weights, log_distributions, traits::lct());
+			return weights.row(n_nodes__ - 1).t();
+		}
+
 		inline double probability(const dvec& assignment, const dvec& distribution)
 		{
 			dvec weights(n_nodes__);
@@ -62,24 +285,45 @@ class Counter__<DNNF>: public Engine__<DNNF, CT>
 			return weight / partition;
 		}
 
-		inline double probability(const init_list<Literal>& term, const dvec& distribution)
+		// Probability of the evidence; the second pass only revisits the
+		// ancestors of the observed literals
+		inline double probability(const Array<Literal>& evidence, const dvec& distribution)
 		{
 			dvec weights(n_nodes__);
-			dvec dis(distribution);
-			push_weights(weights, dis);
+			push_weights(weights, distribution);
 			double partition = weights[n_nodes__ - 1];
-			for(auto p = term.begin(); p != term.end(); ++p)
-			{
-				assert(p->var < n_variables__);
-				if(p->sgn == 1)
-					dis[(2 * p->var) + 1] = 0;
-				else
-					dis[2 * p->var] = 0;
-			}
-			push_weights(weights, dis);
+			uarray literals;
+			for(const Literal& literal : evidence)
+				literals.push_back(literal.sgn ? (2 * literal.var) + 1 : 2 * literal.var);
+			update_weights(weights, observe(distribution, evidence, traits::ct()), literals);
 			double weight = weights[n_nodes__ - 1];
 			return weight / partition;
 		}
+
+		inline double probability(const dvec& assignment, const dvec& log_distribution, traits::lct)
+		{
+			double log_partition = count(log_distribution, traits::lct());
+			double log_weight = get_weight(assignment, log_distribution, traits::lct());
+			return std::exp(log_weight - log_partition);
+		}
+
+		inline double probability(const Array<Literal>& evidence, const dvec& log_distribution, traits::lct)
+		{
+			double log_partition = count(log_distribution, traits::lct());
+			double log_weight = count(observe(log_distribution, evidence, traits::lct()), traits::lct());
+			return std::exp(log_weight - log_partition);
+		}
+
+		// Weighted model count of the models consistent with the evidence
+		inline double count(const dvec& distribution, const Array<Literal>& evidence)
+		{
+			return count(observe(distribution, evidence, traits::ct()));
+		}
+
+		inline double count(const dvec& log_distribution, const Array<Literal>& evidence, traits::lct)
+		{
+			return count(observe(log_distribution, evidence, traits::lct()), traits::lct());
+		}
 };
 
 // -----------------------------------------------------------------------------
@@ -92,9 +336,15 @@ class Counter<DNNF> final : public Counter__<DNNF>
 	public:                 // Traits
 		using base_type = Counter__<DNNF>;
 
+	protected:              // Attributes
+		dvec distribution__;
+		dvec node_weights__;
+
 	public:                 // Constructors & Destructor
 		Counter(const Circuit<DNNF>& circuit) :
-			base_type(circuit)
+			base_type(circuit),
+			distribution__(),
+			node_weights__()
 		{
 		}
 
@@ -112,6 +362,72 @@ class Counter<DNNF> final : public Counter__<DNNF>
 		{
 			return count(distribution);
 		}
+
+		inline dvec operator()(const dmat& distributions)
+		{
+			return count(distributions);
+		}
+
+		inline double operator()(const dvec& distribution, const Array<Literal>& evidence)
+		{
+			return count(distribution, evidence);
+		}
+
+	public:                 // Incremental counting
+		// The counter keeps the literal and node weights of its last update;
+		// the next update only recomputes the nodes affected by the literals
+		// whose weights differ
+		inline double update(const dvec& distribution)
+		{
+			assert(distribution.n_elem == n_literals__);
+			if(node_weights__.n_elem != n_nodes__)
+			{
+				distribution__ = distribution;
+				node_weights__.set_size(n_nodes__);
+				push_weights(node_weights__, distribution__);
+				return node_weights__[n_nodes__ - 1];
+			}
+
+			uarray literals;
+			for(uword l = 0; l < n_literals__; ++l)
+				if(distribution[l] != distribution__[l])
+				{
+					distribution__[l] = distribution[l];
+					literals.push_back(l);
+				}
+			update_weights(node_weights__, distribution__, literals);
+			return node_weights__[n_nodes__ - 1];
+		}
+
+		inline double update(const uarray& literals, const dvec& weights)
+		{
+			assert(literals.size() == weights.n_elem);
+			if(node_weights__.n_elem != n_nodes__)
+			{
+				dvec distribution(n_literals__, arma::fill::ones);
+				update(distribution);
+			}
+
+			for(uword i = 0; i < literals.size(); ++i)
+				distribution__[literals[i]] = weights[i];
+			update_weights(node_weights__, distribution__, literals);
+			return node_weights__[n_nodes__ - 1];
+		}
+
+		inline double operator()(const dvec& log_distribution, traits::lct)
+		{
+			return count(log_distribution, traits::lct());
+		}
+
+		inline dvec operator()(const dmat& log_distributions, traits::lct)
+		{
+			return count(log_distributions, traits::lct());
+		}
+
+		inline double operator()(const dvec& log_distribution, const Array<Literal>& evidence, traits::lct)
+		{
+			return count(log_distribution, evidence, traits::lct());
+		}
 };
 
 #endif
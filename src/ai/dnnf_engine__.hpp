@@ -7,6 +7,8 @@
 #define DNNF_ENGINE__HPP
 
 #include "dnnf_circuit__.hpp"
+#include "../fn/philox__.hpp"
+#include "../fn/thread_pool__.hpp"
 
 // -----------------------------------------------------------------------------
 // Abstract class Engine__<DNNF,Q>
@@ -16,18 +18,32 @@
 template<query_t Q>
 class Engine__<DNNF,Q>
 {
+	public:                 // Parameters
+		// Below n_serial_nodes nodes, or for levels smaller than two chunks,
+		// the traversal is sequential; n_chunk_nodes is the minimal number of
+		// nodes per parallel task
+		static const uword n_serial_nodes = 16384;
+		static const uword n_chunk_nodes = 256;
+		// Number of visits a worker of the task executor counts before
+		// publishing them
+		static const uword n_batch_visits = 64;
+		// Number of queries evaluated together by a batched pass
+		static const uword n_block_lanes = 8;
+
 	protected:              // Attributes
 		const Circuit<DNNF>& circuit__;
 		const uword n_literals__;
 		const uword n_nodes__;
 		const uword n_variables__;
+		executor_t executor__;
 
 	public:                 // Constructors & Destructor
 		Engine__(const Circuit<DNNF>& circuit) :
 			circuit__(circuit),
 			n_literals__(circuit.n_literals()),
 			n_nodes__(circuit.n_nodes()),
-			n_variables__(circuit.n_variables())
+			n_variables__(circuit.n_variables()),
+			executor__(ThreadPool::default_executor())
 		{
 		}
 
@@ -35,53 +51,275 @@ class Engine__<DNNF,Q>
 		{
 		}
 
-	protected:              // Push false node
-		inline void push_false_node(dvec& node_weights,
-		                            const uword index,
-		                            traits::ct)
+	public:                 // Mutators
+		inline void set_executor(const executor_t executor)
 		{
-			node_weights[index] = 0.0;
+			executor__ = executor;
 		}
 
-		inline void push_false_node(dvec& node_weights,
-		                            const uword index,
-		                            traits::min)
+	protected:              // Log-domain arithmetic
+		// log(exp(a) + exp(b)), exact when one of the arguments is -inf
+		inline static double log_add(const double a, const double b)
 		{
-			node_weights[index] = std::numeric_limits<double>::infinity();
+			const double m = (a > b) ? a : b;
+			if(m == -std::numeric_limits<double>::infinity())
+				return m;
+			const double d = (a > b) ? b - a : a - b;
+			return m + std::log1p(std::exp(d));
 		}
 
-		inline void push_false_node(dvec& node_weights,
-		                            const uword index,
-		                            traits::max)
+	protected:              // Traversal
+		// Visits every node after its children, using the executor of the
+		// engine. Small circuits are always traversed sequentially.
+		template<typename F>
+		inline void traverse(F visit)
 		{
-			node_weights[index] = -std::numeric_limits<double>::infinity();
+			ThreadPool& pool = ThreadPool::instance();
+			if(executor__ == SEQUENTIAL || n_nodes__ < n_serial_nodes || pool.n_threads() == 1)
+			{
+				for(uword index = 0; index < n_nodes__; ++index)
+					visit(index);
+				return;
+			}
+
+			if(executor__ == TASKS)
+				traverse_tasks(visit, pool);
+			else
+				traverse_levels(visit, pool);
 		}
 
-		inline void push_false_node(dvec& node_weights, const uword index)
+		// Large circuits are processed level by level, each level being split
+		// into chunks for the thread pool; chunk boundaries are moved so that
+		// two chunks never write to the same cache line (8 doubles) of a
+		// weight vector indexed by node.
+		template<typename F>
+		inline void traverse_levels(F visit, ThreadPool& pool)
 		{
-			push_false_node(node_weights, index, traits::to_query<Q>());
+			uarray bounds;
+			for(uword h = 0; h < circuit__.n_levels(); ++h)
+			{
+				const uword first = circuit__.level_begin(h);
+				const uword last = circuit__.level_end(h);
+				if(last - first < 2 * n_chunk_nodes)
+				{
+					for(uword i = first; i < last; ++i)
+						visit(circuit__.level_node(i));
+					continue;
+				}
+
+				const uword n_chunks = std::min(4 * pool.n_threads(), (last - first) / n_chunk_nodes);
+				const uword chunk_size = (last - first) / n_chunks;
+				bounds.assign(1, first);
+				for(uword c = 1; c < n_chunks; ++c)
+				{
+					uword b = std::max(first + (c * chunk_size), bounds.back());
+					while(b < last && (circuit__.level_node(b) / 8) == (circuit__.level_node(b - 1) / 8))
+						++b;
+					bounds.push_back(b);
+				}
+				bounds.push_back(last);
+
+				pool.parallel_for(bounds.size() - 1, [&](uword c)
+				{
+					for(uword i = bounds[c]; i < bounds[c + 1]; ++i)
+						visit(circuit__.level_node(i));
+				});
+			}
 		}
 
-	protected:              // Push true node
-		inline void push_true_node(dvec& node_weights,
-		                           const uword index,
-		                           traits::ct)
+		// Irregular circuits (a few deep chains next to wide levels) are
+		// processed as a task DAG: each node holds the number of children
+		// still to be visited, and becomes ready when this counter drops to
+		// zero. Ready nodes go to the deque of the worker that released them,
+		// except for the first one which is visited right away; idle workers
+		// steal from the other deques. Leaves are dealt round-robin. Workers
+		// add their visits to the shared counter in batches, and always before
+		// looking for work elsewhere, so that the counter reaches n_nodes once
+		// every worker has run dry.
+		template<typename F>
+		inline void traverse_tasks(F visit, ThreadPool& pool)
 		{
-			node_weights[index] = 1.0;
+			const uword n_workers = pool.n_threads();
+			std::unique_ptr<std::atomic<uword>[]> pending(new std::atomic<uword>[n_nodes__]);
+			std::unique_ptr<TaskDeque[]> deques(new TaskDeque[n_workers]);
+			std::atomic<uword> n_visited(0);
+
+			uword n_leaves = 0;
+			for(uword index = 0; index < n_nodes__; ++index)
+			{
+				const uword n_children = circuit__.n_children(index);
+				pending[index].store(n_children, std::memory_order_relaxed);
+				if(n_children == 0)
+					deques[n_leaves++ % n_workers].push(index);
+			}
+
+			pool.parallel_for(n_workers, [&](uword w)
+			{
+				uword index;
+				uword n_local = 0;
+				bool is_ready = false;
+				while(n_visited.load(std::memory_order_acquire) < n_nodes__)
+				{
+					if(!is_ready && !deques[w].pop(index))
+					{
+						if(n_local > 0)
+						{
+							n_visited.fetch_add(n_local, std::memory_order_release);
+							n_local = 0;
+						}
+						for(uword v = 1; v < n_workers && !is_ready; ++v)
+							is_ready = deques[(w + v) % n_workers].steal(index);
+						if(!is_ready)
+						{
+							std::this_thread::yield();
+							continue;
+						}
+					}
+
+					visit(index);
+					is_ready = false;
+					uword next = index;
+					for(uword e = circuit__.in_begin(index); e < circuit__.in_end(index); ++e)
+					{
+						const uword parent = circuit__.parent(e);
+						if(pending[parent].fetch_sub(1, std::memory_order_acq_rel) != 1)
+							continue;
+						if(is_ready)
+							deques[w].push(parent);
+						else
+						{
+							next = parent;
+							is_ready = true;
+						}
+					}
+					index = next;
+					if(++n_local == n_batch_visits)
+					{
+						n_visited.fetch_add(n_local, std::memory_order_release);
+						n_local = 0;
+					}
+				}
+			});
 		}
 
-		inline void push_true_node(dvec& node_weights,
-		                           const uword index,
-		                           traits::min)
+		// Top-down traversal of the subcircuit selected from root: every child
+		// of an and node is followed, and only the out-edge returned by
+		// choose(index) for an or node; leaf(index) is called on the other
+		// nodes. Each node is visited at most once. The worklist and the
+		// visited bitmap are kept per thread, and the bitmap is cleared from
+		// the worklist afterwards, so a descent does not allocate.
+		template<typename C, typename L>
+		inline void descend(const uword root, C choose, L leaf)
 		{
-			node_weights[index] = 0.0;
+			static thread_local uarray worklist;
+			static thread_local std::vector<bool> visited;
+			if(visited.size() < n_nodes__)
+				visited.resize(n_nodes__, false);
+
+			worklist.clear();
+			worklist.push_back(root);
+			visited[root] = true;
+			for(uword i = 0; i < worklist.size(); ++i)
+			{
+				const uword index = worklist[i];
+				switch(circuit__.node_label(index).type)
+				{
+				case 'a':
+					for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+					{
+						const uword child = circuit__.child(e);
+						if(!visited[child])
+						{
+							visited[child] = true;
+							worklist.push_back(child);
+						}
+					}
+					break;
+
+				case 'o':
+				{
+					const uword child = circuit__.child(choose(index));
+					if(!visited[child])
+					{
+						visited[child] = true;
+						worklist.push_back(child);
+					}
+					break;
+				}
+
+				default:
+					leaf(index);
+				}
+			}
+
+			for(const uword index : worklist)
+				visited[index] = false;
+		}
+
+	protected:              // Constant weights
+		// Weights of the false and true nodes for each query, shared by the
+		// scalar and the batched passes
+		inline static double false_weight(traits::ct)
+		{
+			return 0.0;
+		}
+
+		inline static double false_weight(traits::min)
+		{
+			return std::numeric_limits<double>::infinity();
+		}
+
+		inline static double false_weight(traits::max)
+		{
+			return -std::numeric_limits<double>::infinity();
+		}
+
+		inline static double false_weight(traits::lct)
+		{
+			return false_weight(traits::to_query<MAX>());
+		}
+
+		inline static double true_weight(traits::ct)
+		{
+			return 1.0;
+		}
+
+		inline static double true_weight(traits::min)
+		{
+			return 0.0;
 		}
 
+		inline static double true_weight(traits::max)
+		{
+			return true_weight(traits::to_query<MIN>());
+		}
+
+		inline static double true_weight(traits::lct)
+		{
+			return true_weight(traits::to_query<MIN>());
+		}
+
+	protected:              // Push false node
+		template<typename Query>
+		inline void push_false_node(dvec& node_weights,
+		                            const uword index,
+		                            Query query)
+		{
+			node_weights[index] = false_weight(query);
+		}
+
+		inline void push_false_node(dvec& node_weights, const uword index)
+		{
+			push_false_node(node_weights, index, traits::to_query<Q>());
+		}
+
+	protected:              // Push true node
+		template<typename Query>
 		inline void push_true_node(dvec& node_weights,
 		                           const uword index,
-		                           traits::max)
+		                           Query query)
 		{
-			push_true_node(node_weights, index, traits::to_query<MIN>());
+			node_weights[index] = true_weight(query);
 		}
 
 		inline void push_true_node(dvec& node_weights, const uword index)
@@ -94,7 +332,7 @@ class Engine__<DNNF,Q>
 		                              const uword index,
 		                              const dvec& literal_weights)
 		{
-			uword x = circuit__.node_label(index).vars[0];
+			uword x = circuit__.node_label(index).var;
 			if(circuit__.node_label(index).sgn)
 				node_weights[index] = literal_weights[2 * x];
 			else
@@ -106,20 +344,18 @@ class Engine__<DNNF,Q>
 		                          const uword index,
 		                          traits::ct)
 		{
-			auto children = circuit__.out_edges(index);
 			node_weights[index] = 1.0;
-			for(auto c = children.begin(); c != children.end(); ++c)
-				node_weights[index] *= node_weights[c.col()];
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+				node_weights[index] *= node_weights[circuit__.child(e)];
 		}
 
 		inline void push_and_node(dvec& node_weights,
 		                          const uword index,
 		                          traits::min)
 		{
-			auto children = circuit__.out_edges(index);
 			node_weights[index] = 0.0;
-			for(auto c = children.begin(); c != children.end(); ++c)
-				node_weights[index] += node_weights[c.col()];
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+				node_weights[index] += node_weights[circuit__.child(e)];
 		}
 
 		inline void push_and_node(dvec& node_weights,
@@ -129,6 +365,13 @@ class Engine__<DNNF,Q>
 			push_and_node(node_weights, index, traits::to_query<MIN>());
 		}
 
+		inline void push_and_node(dvec& node_weights,
+		                          const uword index,
+		                          traits::lct)
+		{
+			push_and_node(node_weights, index, traits::to_query<MIN>());
+		}
+
 		inline void push_and_node(dvec& node_weights, const uword index)
 		{
 			push_and_node(node_weights, index, traits::to_query<Q>());
@@ -140,16 +383,14 @@ class Engine__<DNNF,Q>
 		                         const dvec& literal_weights,
 		                         traits::ct)
 		{
-			auto children = circuit__.out_edges(index);
 			node_weights[index] = 0.0;
-			for(auto c = children.begin(); c != children.end(); ++c)
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
 			{
-				uword child = c.col();
-				const uvec& vars = circuit__.edge_label(index, child);
+				uword child = circuit__.child(e);
 				double edge_weight = 1;
-				for(uword i = 0; i < vars.size(); ++i)
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
 				{
-					uword x = vars[i];
+					uword x = circuit__.label(i);
 					double w = literal_weights[2 * x] + literal_weights[(2 * x) + 1];
 					edge_weight *= w;
 				}
@@ -157,78 +398,113 @@ class Engine__<DNNF,Q>
 			}
 		}
 
-		inline void push_or_node(sp_dmat& edge_weights,
+		inline void push_or_node(dvec& edge_weights,
 		                         dvec& node_weights,
 		                         const uword index,
 		                         const dvec& literal_weights,
 		                         traits::ct)
 		{
-			auto children = circuit__.out_edges(index);
 			node_weights[index] = 0.0;
-			for(auto c = children.begin(); c != children.end(); ++c)
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
 			{
-				uword child = c.col();
-				const uvec& vars = circuit__.edge_label(index, child);
+				uword child = circuit__.child(e);
 				double edge_weight = 1;
-				for(uword i = 0; i < vars.size(); ++i)
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
 				{
-					uword x = vars[i];
+					uword x = circuit__.label(i);
 					double w = literal_weights[2 * x] + literal_weights[(2 * x) + 1];
 					edge_weight *= w;
 				}
-				edge_weights(index, child) = (edge_weight * node_weights[child]);
+				edge_weights[e] = (edge_weight * node_weights[child]);
 				node_weights[index] += (edge_weight * node_weights[child]);
 			}
 		}
 
-		inline void push_or_node(sp_dmat& edge_weights,
+		inline void push_or_node(dvec& edge_weights,
 		                         dvec& node_weights,
 		                         const uword index,
 		                         const dvec& literal_weights,
 		                         traits::min)
 		{
-			auto children = circuit__.out_edges(index);
 			node_weights[index] = std::numeric_limits<double>::infinity();
-			for(auto c = children.begin(); c != children.end(); ++c)
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
 			{
-				uword child = c.col();
-				const uvec& vars = circuit__.edge_label(index, child);
+				uword child = circuit__.child(e);
 				double edge_weight = 0;
-				for(uword i = 0; i < vars.size(); ++i)
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
 				{
-					uword x = vars[i];
+					uword x = circuit__.label(i);
 					double w = std::min(literal_weights[2 * x], literal_weights[(2 * x) + 1]);
 					edge_weight += w;
 				}
-				edge_weights(index, child) = edge_weight + node_weights[child];
+				edge_weights[e] = edge_weight + node_weights[child];
 				node_weights[index] = std::min(node_weights[index], edge_weight + node_weights[child]);
 			}
 		}
 
-		inline void push_or_node(sp_dmat& edge_weights,
+		inline void push_or_node(dvec& edge_weights,
 		                         dvec& node_weights,
 		                         const uword index,
 		                         const dvec& literal_weights,
 		                         traits::max)
 		{
-			auto children = circuit__.out_edges(index);
 			node_weights[index] = -std::numeric_limits<double>::infinity();
-			for(auto c = children.begin(); c != children.end(); ++c)
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
 			{
-				uword child = c.col();
-				const uvec& vars = circuit__.edge_label(index, child);
+				uword child = circuit__.child(e);
 				double edge_weight = 0;
-				for(uword i = 0; i < vars.size(); ++i)
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
 				{
-					uword x = vars[i];
+					uword x = circuit__.label(i);
 					double w = std::max(literal_weights[2 * x], literal_weights[(2 * x) + 1]);
 					edge_weight += w;
 				}
-				edge_weights(index, child) = edge_weight + node_weights[child];
+				edge_weights[e] = edge_weight + node_weights[child];
 				node_weights[index] = std::max(node_weights[index], edge_weight + node_weights[child]);
 			}
 		}
 
+		// Log-domain or node: a gap variable contributes log(w_x + w_-x) and
+		// the edges are combined by log-sum-exp
+		inline void push_or_node(dvec& node_weights,
+		                         const uword index,
+		                         const dvec& literal_weights,
+		                         traits::lct)
+		{
+			node_weights[index] = -std::numeric_limits<double>::infinity();
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				uword child = circuit__.child(e);
+				double edge_weight = 0;
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					edge_weight += log_add(literal_weights[2 * x], literal_weights[(2 * x) + 1]);
+				}
+				node_weights[index] = log_add(node_weights[index], edge_weight + node_weights[child]);
+			}
+		}
+
+		inline void push_or_node(dvec& edge_weights,
+		                         dvec& node_weights,
+		                         const uword index,
+		                         const dvec& literal_weights,
+		                         traits::lct)
+		{
+			node_weights[index] = -std::numeric_limits<double>::infinity();
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				uword child = circuit__.child(e);
+				double edge_weight = 0;
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					edge_weight += log_add(literal_weights[2 * x], literal_weights[(2 * x) + 1]);
+				}
+				edge_weights[e] = edge_weight + node_weights[child];
+				node_weights[index] = log_add(node_weights[index], edge_weight + node_weights[child]);
+			}
+		}
 
 		inline void push_or_node(dvec& node_weights,
 		                         const uword index,
@@ -237,7 +513,7 @@ class Engine__<DNNF,Q>
 			push_or_node(node_weights, index, literal_weights, traits::to_query<Q>());
 		}
 
-		inline void push_or_node(sp_dmat& edge_weights,
+		inline void push_or_node(dvec& edge_weights,
 		                         dvec& node_weights,
 		                         const uword index,
 		                         const dvec& literal_weights)
@@ -245,6 +521,509 @@ class Engine__<DNNF,Q>
 			push_or_node(edge_weights, node_weights, index, literal_weights, traits::to_query<Q>());
 		}
 
+	protected:              // Push lanes (batched weights)
+		// In batched mode, the weights of a node for K queries are stored as
+		// one column of K contiguous lanes, so that every node operation is a
+		// plain loop over the lanes which the compiler can vectorize
+		inline void push_constant_lanes(dmat& node_lanes, const uword index, const double value)
+		{
+			double* __restrict__ out = node_lanes.colptr(index);
+			for(uword k = 0; k < node_lanes.n_rows; ++k)
+				out[k] = value;
+		}
+
+		inline void push_literal_lanes(dmat& node_lanes,
+		                               const uword index,
+		                               const dmat& literal_lanes)
+		{
+			uword x = circuit__.node_label(index).var;
+			uword l = circuit__.node_label(index).sgn ? 2 * x : (2 * x) + 1;
+			double* __restrict__ out = node_lanes.colptr(index);
+			const double* __restrict__ in = literal_lanes.colptr(l);
+			for(uword k = 0; k < node_lanes.n_rows; ++k)
+				out[k] = in[k];
+		}
+
+		inline void push_and_lanes(dmat& node_lanes,
+		                           const uword index,
+		                           traits::ct)
+		{
+			const uword n_lanes = node_lanes.n_rows;
+			double* __restrict__ out = node_lanes.colptr(index);
+			for(uword k = 0; k < n_lanes; ++k)
+				out[k] = 1.0;
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				const double* __restrict__ in = node_lanes.colptr(circuit__.child(e));
+				for(uword k = 0; k < n_lanes; ++k)
+					out[k] *= in[k];
+			}
+		}
+
+		inline void push_and_lanes(dmat& node_lanes,
+		                           const uword index,
+		                           traits::min)
+		{
+			const uword n_lanes = node_lanes.n_rows;
+			double* __restrict__ out = node_lanes.colptr(index);
+			for(uword k = 0; k < n_lanes; ++k)
+				out[k] = 0.0;
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				const double* __restrict__ in = node_lanes.colptr(circuit__.child(e));
+				for(uword k = 0; k < n_lanes; ++k)
+					out[k] += in[k];
+			}
+		}
+
+		inline void push_and_lanes(dmat& node_lanes,
+		                           const uword index,
+		                           traits::max)
+		{
+			push_and_lanes(node_lanes, index, traits::to_query<MIN>());
+		}
+
+		inline void push_and_lanes(dmat& node_lanes,
+		                           const uword index,
+		                           traits::lct)
+		{
+			push_and_lanes(node_lanes, index, traits::to_query<MIN>());
+		}
+
+		// The gap weights of an or-edge are accumulated in the lanes of a
+		// scratch vector before being combined with the child lanes
+		inline void push_or_lanes(dmat& node_lanes,
+		                          dmat& edge_lanes,
+		                          const uword index,
+		                          const dmat& literal_lanes,
+		                          traits::ct)
+		{
+			const uword n_lanes = node_lanes.n_rows;
+			double* __restrict__ out = node_lanes.colptr(index);
+			double* __restrict__ edge = edge_lanes.colptr(0);
+			for(uword k = 0; k < n_lanes; ++k)
+				out[k] = 0.0;
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				const double* __restrict__ in = node_lanes.colptr(circuit__.child(e));
+				for(uword k = 0; k < n_lanes; ++k)
+					edge[k] = 1.0;
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					const double* __restrict__ pos = literal_lanes.colptr(2 * x);
+					const double* __restrict__ neg = literal_lanes.colptr((2 * x) + 1);
+					for(uword k = 0; k < n_lanes; ++k)
+						edge[k] *= pos[k] + neg[k];
+				}
+				for(uword k = 0; k < n_lanes; ++k)
+					out[k] += edge[k] * in[k];
+			}
+		}
+
+		inline void push_or_lanes(dmat& node_lanes,
+		                          dmat& edge_lanes,
+		                          const uword index,
+		                          const dmat& literal_lanes,
+		                          traits::min)
+		{
+			const uword n_lanes = node_lanes.n_rows;
+			double* __restrict__ out = node_lanes.colptr(index);
+			double* __restrict__ edge = edge_lanes.colptr(0);
+			for(uword k = 0; k < n_lanes; ++k)
+				out[k] = std::numeric_limits<double>::infinity();
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				const double* __restrict__ in = node_lanes.colptr(circuit__.child(e));
+				for(uword k = 0; k < n_lanes; ++k)
+					edge[k] = 0.0;
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					const double* __restrict__ pos = literal_lanes.colptr(2 * x);
+					const double* __restrict__ neg = literal_lanes.colptr((2 * x) + 1);
+					for(uword k = 0; k < n_lanes; ++k)
+						edge[k] += (pos[k] < neg[k]) ? pos[k] : neg[k];
+				}
+				for(uword k = 0; k < n_lanes; ++k)
+				{
+					double w = edge[k] + in[k];
+					out[k] = (w < out[k]) ? w : out[k];
+				}
+			}
+		}
+
+		inline void push_or_lanes(dmat& node_lanes,
+		                          dmat& edge_lanes,
+		                          const uword index,
+		                          const dmat& literal_lanes,
+		                          traits::max)
+		{
+			const uword n_lanes = node_lanes.n_rows;
+			double* __restrict__ out = node_lanes.colptr(index);
+			double* __restrict__ edge = edge_lanes.colptr(0);
+			for(uword k = 0; k < n_lanes; ++k)
+				out[k] = -std::numeric_limits<double>::infinity();
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				const double* __restrict__ in = node_lanes.colptr(circuit__.child(e));
+				for(uword k = 0; k < n_lanes; ++k)
+					edge[k] = 0.0;
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					const double* __restrict__ pos = literal_lanes.colptr(2 * x);
+					const double* __restrict__ neg = literal_lanes.colptr((2 * x) + 1);
+					for(uword k = 0; k < n_lanes; ++k)
+						edge[k] += (pos[k] > neg[k]) ? pos[k] : neg[k];
+				}
+				for(uword k = 0; k < n_lanes; ++k)
+				{
+					double w = edge[k] + in[k];
+					out[k] = (w > out[k]) ? w : out[k];
+				}
+			}
+		}
+
+		// Log-domain or lanes: the edges are combined by an online log-sum-exp
+		// which keeps a running maximum (in the node lanes) and a rescaled sum
+		// (in the second column of the scratch matrix)
+		inline void push_or_lanes(dmat& node_lanes,
+		                          dmat& edge_lanes,
+		                          const uword index,
+		                          const dmat& literal_lanes,
+		                          traits::lct)
+		{
+			const double ninf = -std::numeric_limits<double>::infinity();
+			const uword n_lanes = node_lanes.n_rows;
+			double* __restrict__ out = node_lanes.colptr(index);
+			double* __restrict__ edge = edge_lanes.colptr(0);
+			double* __restrict__ sum = edge_lanes.colptr(1);
+			for(uword k = 0; k < n_lanes; ++k)
+			{
+				out[k] = ninf;
+				sum[k] = 0.0;
+			}
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				const double* __restrict__ in = node_lanes.colptr(circuit__.child(e));
+				for(uword k = 0; k < n_lanes; ++k)
+					edge[k] = 0.0;
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					const double* __restrict__ pos = literal_lanes.colptr(2 * x);
+					const double* __restrict__ neg = literal_lanes.colptr((2 * x) + 1);
+					for(uword k = 0; k < n_lanes; ++k)
+					{
+						double m = (pos[k] > neg[k]) ? pos[k] : neg[k];
+						double d = (pos[k] > neg[k]) ? neg[k] - pos[k] : pos[k] - neg[k];
+						edge[k] += (m == ninf) ? ninf : m + std::log1p(std::exp(d));
+					}
+				}
+				for(uword k = 0; k < n_lanes; ++k)
+				{
+					double w = edge[k] + in[k];
+					double m = (w > out[k]) ? w : out[k];
+					if(m != ninf)
+						sum[k] = (sum[k] * std::exp(out[k] - m)) + std::exp(w - m);
+					out[k] = m;
+				}
+			}
+			for(uword k = 0; k < n_lanes; ++k)
+				out[k] += std::log(sum[k]);
+		}
+
+	protected:              // Push integer lanes (min-plus and max-plus)
+		// Integral objectives can be evaluated with integer node values, so
+		// that twice (int32) or four times (int16) as many lanes fit in a
+		// vector register. The absorbing sentinel (max for min-plus, lowest
+		// for max-plus) stands for an infeasible node; finite sums saturate
+		// one step before the sentinels so that they never become infeasible.
+		template<typename T>
+		using wide_t = typename std::conditional<(sizeof(T) < 4), std::int32_t, std::int64_t>::type;
+
+		template<typename T>
+		inline static T false_value(traits::min)
+		{
+			return std::numeric_limits<T>::max();
+		}
+
+		template<typename T>
+		inline static T false_value(traits::max)
+		{
+			return std::numeric_limits<T>::lowest();
+		}
+
+		template<typename T, typename Tag>
+		inline static T saturated_add(const T a, const T b, Tag tag)
+		{
+			const T infinite = false_value<T>(tag);
+			const wide_t<T> lowest = (wide_t<T>)std::numeric_limits<T>::lowest() + 1;
+			const wide_t<T> highest = (wide_t<T>)std::numeric_limits<T>::max() - 1;
+			wide_t<T> sum = (wide_t<T>)a + (wide_t<T>)b;
+			sum = (sum < lowest) ? lowest : ((sum > highest) ? highest : sum);
+			return (a == infinite || b == infinite) ? infinite : (T)sum;
+		}
+
+		template<typename T>
+		inline static T select(const T a, const T b, traits::min)
+		{
+			return (a < b) ? a : b;
+		}
+
+		template<typename T>
+		inline static T select(const T a, const T b, traits::max)
+		{
+			return (a > b) ? a : b;
+		}
+
+		template<typename T>
+		inline void push_integer_lanes(arma::Mat<T>& node_lanes,
+		                               const uword index,
+		                               const arma::Mat<T>& literal_lanes)
+		{
+			uword x = circuit__.node_label(index).var;
+			uword l = circuit__.node_label(index).sgn ? 2 * x : (2 * x) + 1;
+			T* __restrict__ out = node_lanes.colptr(index);
+			const T* __restrict__ in = literal_lanes.colptr(l);
+			for(uword k = 0; k < node_lanes.n_rows; ++k)
+				out[k] = in[k];
+		}
+
+		template<typename T>
+		inline void push_integer_lanes(arma::Mat<T>& node_lanes, const uword index, const T value)
+		{
+			T* __restrict__ out = node_lanes.colptr(index);
+			for(uword k = 0; k < node_lanes.n_rows; ++k)
+				out[k] = value;
+		}
+
+		template<typename T, typename Tag>
+		inline void push_integer_and_lanes(arma::Mat<T>& node_lanes, const uword index, Tag tag)
+		{
+			const uword n_lanes = node_lanes.n_rows;
+			T* __restrict__ out = node_lanes.colptr(index);
+			for(uword k = 0; k < n_lanes; ++k)
+				out[k] = 0;
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				const T* __restrict__ in = node_lanes.colptr(circuit__.child(e));
+				for(uword k = 0; k < n_lanes; ++k)
+					out[k] = saturated_add(out[k], in[k], tag);
+			}
+		}
+
+		template<typename T, typename Tag>
+		inline void push_integer_or_lanes(arma::Mat<T>& node_lanes,
+		                                  arma::Mat<T>& edge_lanes,
+		                                  const uword index,
+		                                  const arma::Mat<T>& literal_lanes,
+		                                  Tag tag)
+		{
+			const uword n_lanes = node_lanes.n_rows;
+			T* __restrict__ out = node_lanes.colptr(index);
+			T* __restrict__ edge = edge_lanes.colptr(0);
+			for(uword k = 0; k < n_lanes; ++k)
+				out[k] = false_value<T>(tag);
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				const T* __restrict__ in = node_lanes.colptr(circuit__.child(e));
+				for(uword k = 0; k < n_lanes; ++k)
+					edge[k] = 0;
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					const T* __restrict__ pos = literal_lanes.colptr(2 * x);
+					const T* __restrict__ neg = literal_lanes.colptr((2 * x) + 1);
+					for(uword k = 0; k < n_lanes; ++k)
+						edge[k] = saturated_add(edge[k], select(pos[k], neg[k], tag), tag);
+				}
+				for(uword k = 0; k < n_lanes; ++k)
+					out[k] = select(out[k], saturated_add(edge[k], in[k], tag), tag);
+			}
+		}
+
+	protected:              // Pull literal node
+		inline void pull_literal_node(dvec& literal_derivatives,
+		                              const dvec& node_derivatives,
+		                              const uword index,
+		                              traits::ct)
+		{
+			uword x = circuit__.node_label(index).var;
+			if(circuit__.node_label(index).sgn)
+				literal_derivatives[2 * x] += node_derivatives[index];
+			else
+				literal_derivatives[(2 * x) + 1] += node_derivatives[index];
+		}
+
+		inline void pull_literal_node(dvec& literal_derivatives,
+		                              const dvec& node_derivatives,
+		                              const uword index,
+		                              traits::lct)
+		{
+			pull_literal_node(literal_derivatives, node_derivatives, index, traits::to_query<CT>());
+		}
+
+		inline void pull_literal_node(dvec& literal_derivatives,
+		                              const dvec& node_derivatives,
+		                              const uword index)
+		{
+			pull_literal_node(literal_derivatives, node_derivatives, index, traits::to_query<Q>());
+		}
+
+	protected:              // Pull and node
+		// The partial derivative with respect to a child is the product of its
+		// siblings, obtained from prefix and suffix products (no division, so
+		// zero-weighted siblings are handled exactly)
+		inline void pull_and_node(dvec& node_derivatives,
+		                          std::vector<double>& partials,
+		                          const dvec& node_weights,
+		                          const uword index,
+		                          traits::ct)
+		{
+			const double derivative = node_derivatives[index];
+			if(derivative == 0.0)
+				return;
+
+			const uword first = circuit__.out_begin(index);
+			const uword last = circuit__.out_end(index);
+			if(partials.size() < last - first)
+				partials.resize(last - first);
+
+			double prefix = derivative;
+			for(uword e = first; e < last; ++e)
+			{
+				partials[e - first] = prefix;
+				prefix *= node_weights[circuit__.child(e)];
+			}
+
+			double suffix = 1.0;
+			for(uword e = last; e-- > first;)
+			{
+				uword child = circuit__.child(e);
+				node_derivatives[child] += partials[e - first] * suffix;
+				suffix *= node_weights[child];
+			}
+		}
+
+		// In the log domain, the pass propagates flows (w dZ/dw) / Z instead
+		// of derivatives; the flow of an and node goes unchanged to each child
+		inline void pull_and_node(dvec& node_derivatives,
+		                          std::vector<double>&,
+		                          const dvec&,
+		                          const uword index,
+		                          traits::lct)
+		{
+			const double flow = node_derivatives[index];
+			if(flow == 0.0)
+				return;
+
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+				node_derivatives[circuit__.child(e)] += flow;
+		}
+
+		inline void pull_and_node(dvec& node_derivatives,
+		                          std::vector<double>& partials,
+		                          const dvec& node_weights,
+		                          const uword index)
+		{
+			pull_and_node(node_derivatives, partials, node_weights, index, traits::to_query<Q>());
+		}
+
+	protected:              // Pull or node
+		// Each gap variable x of an or-edge contributes the factor w_x + w_-x,
+		// whose derivative with respect to both literals of x is the product of
+		// the other factors of the edge
+		inline void pull_or_node(dvec& literal_derivatives,
+		                         dvec& node_derivatives,
+		                         std::vector<double>& partials,
+		                         const dvec& node_weights,
+		                         const uword index,
+		                         const dvec& literal_weights,
+		                         traits::ct)
+		{
+			const double derivative = node_derivatives[index];
+			if(derivative == 0.0)
+				return;
+
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				uword child = circuit__.child(e);
+				const uword first = circuit__.label_begin(e);
+				const uword last = circuit__.label_end(e);
+				if(partials.size() < last - first)
+					partials.resize(last - first);
+
+				double prefix = derivative;
+				for(uword i = first; i < last; ++i)
+				{
+					uword x = circuit__.label(i);
+					partials[i - first] = prefix;
+					prefix *= literal_weights[2 * x] + literal_weights[(2 * x) + 1];
+				}
+				node_derivatives[child] += prefix;
+
+				double suffix = node_weights[child];
+				for(uword i = last; i-- > first;)
+				{
+					uword x = circuit__.label(i);
+					double w = partials[i - first] * suffix;
+					literal_derivatives[2 * x] += w;
+					literal_derivatives[(2 * x) + 1] += w;
+					suffix *= literal_weights[2 * x] + literal_weights[(2 * x) + 1];
+				}
+			}
+		}
+
+		// Log-domain or node: the flow is split among the edges in proportion
+		// to their weights, and among the two literals of each gap variable
+		inline void pull_or_node(dvec& literal_derivatives,
+		                         dvec& node_derivatives,
+		                         std::vector<double>&,
+		                         const dvec& node_weights,
+		                         const uword index,
+		                         const dvec& literal_weights,
+		                         traits::lct)
+		{
+			const double flow = node_derivatives[index];
+			if(flow == 0.0)
+				return;
+
+			for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+			{
+				uword child = circuit__.child(e);
+				double edge_weight = 0;
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					edge_weight += log_add(literal_weights[2 * x], literal_weights[(2 * x) + 1]);
+				}
+				double edge_flow = flow * std::exp(edge_weight + node_weights[child] - node_weights[index]);
+				if(edge_flow == 0.0)
+					continue;
+
+				node_derivatives[child] += edge_flow;
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					double w = log_add(literal_weights[2 * x], literal_weights[(2 * x) + 1]);
+					literal_derivatives[2 * x] += edge_flow * std::exp(literal_weights[2 * x] - w);
+					literal_derivatives[(2 * x) + 1] += edge_flow * std::exp(literal_weights[(2 * x) + 1] - w);
+				}
+			}
+		}
+
+		inline void pull_or_node(dvec& literal_derivatives,
+		                         dvec& node_derivatives,
+		                         std::vector<double>& partials,
+		                         const dvec& node_weights,
+		                         const uword index,
+		                         const dvec& literal_weights)
+		{
+			pull_or_node(literal_derivatives, node_derivatives, partials, node_weights, index, literal_weights, traits::to_query<Q>());
+		}
+
 	protected:              // get_weight
 		inline static double get_weight(const dvec& assignment,
 		                                const dvec& objective,
@@ -273,23 +1052,275 @@ class Engine__<DNNF,Q>
 			return w;
 		}
 
+		inline static double get_weight(const dvec& assignment,
+		                                const dvec& objective,
+		                                traits::lct)
+		{
+			assert(objective.n_elem == assignment.n_elem);
+			double w = 0;
+			for(uword x = 0; x < assignment.n_elem; ++x)
+				if(assignment[x] == 1.0)
+					w += objective[x];
+			return w;
+		}
+
+	protected:              // k-best semiring
+		// A ranking is the sorted list of the (at most) k best values of a
+		// node, of a prefix of the out-edges of an and node, or of a prefix
+		// of the gap variables of an or-edge. Each entry points back to the
+		// entries it was built from: its two ranks for a combination, or its
+		// out-edge and the rank in that edge's ranking at an or node.
+		struct Ranked
+		{
+			double value;
+			uword first;
+			uword second;
+		};
+
+		using Ranking = Array<Ranked>;
+
+		inline static bool is_better(const double a, const double b, traits::min)
+		{
+			return a < b;
+		}
+
+		inline static bool is_better(const double a, const double b, traits::max)
+		{
+			return a > b;
+		}
+
+		// The k best pairwise sums of two rankings, enumerated lazily from
+		// (0, 0): (i, j) enables (i, j + 1), and (i, 0) enables (i + 1, 0),
+		// so that every pair enters the frontier once and after a better one
+		template<typename T>
+		inline static void combine(const Ranking& left,
+		                           const Ranking& right,
+		                           Ranking& result,
+		                           const uword k,
+		                           T tag)
+		{
+			result.clear();
+			if(left.empty() || right.empty())
+				return;
+
+			auto is_worse = [&](const Ranked& a, const Ranked& b)
+			{
+				return is_better(b.value, a.value, tag);
+			};
+			std::priority_queue<Ranked, Array<Ranked>, decltype(is_worse)> frontier(is_worse);
+			frontier.push({left[0].value + right[0].value, 0, 0});
+			while(!frontier.empty() && result.size() < k)
+			{
+				const Ranked top = frontier.top();
+				frontier.pop();
+				result.push_back(top);
+				if(top.second + 1 < right.size())
+					frontier.push({left[top.first].value + right[top.second + 1].value, top.first, top.second + 1});
+				if(top.second == 0 && top.first + 1 < left.size())
+					frontier.push({left[top.first + 1].value + right[0].value, top.first + 1, 0});
+			}
+		}
+
+		// Gap variable x: its best literal (the positive one on ties) comes
+		// first, and the flipped one second
+		template<typename T>
+		inline static bool is_positive_best(const uword x, const dvec& literal_weights, T tag)
+		{
+			return !is_better(literal_weights[(2 * x) + 1], literal_weights[2 * x], tag);
+		}
+
+		inline const Ranking& edge_ranking(const Array<Ranking>& node_rankings,
+		                                   const Array<Ranking>& label_rankings,
+		                                   const uword edge) const
+		{
+			if(circuit__.label_begin(edge) < circuit__.label_end(edge))
+				return label_rankings[circuit__.label_end(edge) - 1];
+			return node_rankings[circuit__.child(edge)];
+		}
+
+		template<typename T>
+		inline void push_ranking(Array<Ranking>& node_rankings,
+		                         Array<Ranking>& edge_rankings,
+		                         Array<Ranking>& label_rankings,
+		                         const uword index,
+		                         const dvec& literal_weights,
+		                         const uword k,
+		                         T tag)
+		{
+			Ranking& ranking = node_rankings[index];
+			ranking.clear();
+			const uword first = circuit__.out_begin(index);
+			const uword last = circuit__.out_end(index);
+			switch(circuit__.node_label(index).type)
+			{
+			case 'f':
+				return;
+
+			case 't':
+				ranking.push_back({0.0, 0, 0});
+				return;
+
+			case 'l':
+			{
+				uword x = circuit__.node_label(index).var;
+				uword l = circuit__.node_label(index).sgn ? 2 * x : (2 * x) + 1;
+				ranking.push_back({literal_weights[l], 0, 0});
+				return;
+			}
+
+			case 'a':
+				if(first == last)
+				{
+					ranking.push_back({0.0, 0, 0});
+					return;
+				}
+				for(uword e = first; e < last; ++e)
+				{
+					const Ranking& child = node_rankings[circuit__.child(e)];
+					if(e == first)
+					{
+						edge_rankings[e].clear();
+						for(uword r = 0; r < child.size(); ++r)
+							edge_rankings[e].push_back({child[r].value, r, 0});
+					}
+					else
+						combine(edge_rankings[e - 1], child, edge_rankings[e], k, tag);
+				}
+				ranking = edge_rankings[last - 1];
+				return;
+			}
+
+			// Or node: gap variables are combined into each out-edge, then the
+			// out-edges are merged k-way
+			for(uword e = first; e < last; ++e)
+			{
+				const Ranking* previous = &node_rankings[circuit__.child(e)];
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					bool is_positive = is_positive_best(x, literal_weights, tag);
+					Ranking gap = {{literal_weights[is_positive ? 2 * x : (2 * x) + 1], 0, 0},
+					               {literal_weights[is_positive ? (2 * x) + 1 : 2 * x], 1, 0}};
+					combine(*previous, gap, label_rankings[i], k, tag);
+					previous = &label_rankings[i];
+				}
+			}
+
+			auto is_worse = [&](const Ranked& a, const Ranked& b)
+			{
+				return is_better(b.value, a.value, tag);
+			};
+			std::priority_queue<Ranked, Array<Ranked>, decltype(is_worse)> frontier(is_worse);
+			for(uword e = first; e < last; ++e)
+			{
+				const Ranking& edge = edge_ranking(node_rankings, label_rankings, e);
+				if(!edge.empty())
+					frontier.push({edge[0].value, e, 0});
+			}
+			while(!frontier.empty() && ranking.size() < k)
+			{
+				const Ranked top = frontier.top();
+				frontier.pop();
+				ranking.push_back(top);
+				const Ranking& edge = edge_ranking(node_rankings, label_rankings, top.first);
+				if(top.second + 1 < edge.size())
+					frontier.push({edge[top.second + 1].value, top.first, top.second + 1});
+			}
+		}
+
+	protected:              // Evidence
+		// A partial assignment is enforced by giving the opposite literal of
+		// each observed one the weight of false, so that a single pass with
+		// the masked weights answers every query under the evidence
+		template<query_t R>
+		inline dvec observe(const dvec& literal_weights,
+		                    const Array<Literal>& evidence,
+		                    std::integral_constant<query_t, R> query) const
+		{
+			dvec weights(literal_weights);
+			for(const Literal& literal : evidence)
+			{
+				assert(literal.var < n_variables__);
+				weights[literal.sgn ? (2 * literal.var) + 1 : 2 * literal.var] = false_weight(query);
+			}
+			return weights;
+		}
+
 	public:                 // public inference operations
 		inline static double get_weight(const dvec& assignment, const dvec& objective)
 		{
 			return get_weight(assignment,objective,traits::to_query<Q>());
 		}
 
+		// The query tag selects the semiring, which defaults to the query of
+		// the engine; counters can also be run in the log domain (traits::lct)
+		template<query_t R>
+		inline void push_node(dvec& node_weights,
+		                      const uword index,
+		                      const dvec& literal_weights,
+		                      std::integral_constant<query_t, R> query)
+		{
+			switch(circuit__.node_label(index).type)
+			{
+			case 'a':
+				push_and_node(node_weights, index, query);
+				break;
+
+			case 'f':
+				push_false_node(node_weights, index, query);
+				break;
+
+			case 'l':
+				push_literal_node(node_weights, index, literal_weights);
+				break;
+
+			case 'o':
+				push_or_node(node_weights, index, literal_weights, query);
+				break;
+
+			case 't':
+				push_true_node(node_weights, index, query);
+				break;
+			}
+		}
+
+		template<query_t R>
+		inline void push_weights(dvec& node_weights,
+		                         const dvec& literal_weights,
+		                         std::integral_constant<query_t, R> query)
+		{
+			traverse([&](uword index)
+			{
+				push_node(node_weights, index, literal_weights, query);
+			});
+		}
+
 		inline void push_weights(dvec& node_weights, const dvec& literal_weights)
 		{
-			for(uword index = 0; index < n_nodes__; ++index)
+			push_weights(node_weights, literal_weights, traits::to_query<Q>());
+		}
+
+		// Pass with edge scores: edge_weights is indexed by edge id (n_edges
+		// entries), and holds the score of each out-edge of an or node, gap
+		// variables included. There is one edge per (parent, child) pair,
+		// since the loader merges repeated children: idempotent below an and
+		// node, and excluded by determinism below an or node.
+		template<query_t R>
+		inline void push_weights(dvec& edge_weights,
+		                         dvec& node_weights,
+		                         const dvec& literal_weights,
+		                         std::integral_constant<query_t, R> query)
+		{
+			traverse([&](uword index)
+			{
 				switch(circuit__.node_label(index).type)
 				{
 				case 'a':
-					push_and_node(node_weights, index);
+					push_and_node(node_weights, index, query);
 					break;
 
 				case 'f':
-					push_false_node(node_weights, index);
+					push_false_node(node_weights, index, query);
 					break;
 
 				case 'l':
@@ -297,38 +1328,251 @@ class Engine__<DNNF,Q>
 					break;
 
 				case 'o':
-					push_or_node(node_weights, index, literal_weights);
+					push_or_node(edge_weights, node_weights, index, literal_weights, query);
 					break;
 
 				case 't':
-					push_true_node(node_weights, index);
+					push_true_node(node_weights, index, query);
 					break;
 				}
+			});
 		}
 
-		inline void push_weights(sp_dmat& edge_weights, dvec& node_weights, const dvec& literal_weights)
+		// k-best pass: node_rankings, edge_rankings and label_rankings are
+		// indexed by node, edge id and label position, and receive the k best
+		// values of the corresponding subcircuits (see push_ranking)
+		template<query_t R>
+		inline void push_rankings(Array<Ranking>& node_rankings,
+		                          Array<Ranking>& edge_rankings,
+		                          Array<Ranking>& label_rankings,
+		                          const dvec& literal_weights,
+		                          const uword k,
+		                          std::integral_constant<query_t, R> query)
 		{
-			for(uword index = 0; index < n_nodes__; ++index)
+			node_rankings.resize(n_nodes__);
+			edge_rankings.resize(circuit__.n_edges());
+			label_rankings.resize(circuit__.n_labels());
+			traverse([&](uword index)
+			{
+				push_ranking(node_rankings, edge_rankings, label_rankings, index, literal_weights, k, query);
+			});
+		}
+
+		// Incremental pass: node_weights holds the result of a previous pass,
+		// and only the given literals have changed since then. The nodes that
+		// depend on them (occurrence index) are recomputed in topological
+		// order, that is by increasing index through a min-heap, and a node
+		// whose weight is unchanged does not propagate to its parents. When
+		// the seeds already cover a large part of the circuit, a full pass is
+		// cheaper than the heap.
+		template<query_t R>
+		inline void update_weights(dvec& node_weights,
+		                           const dvec& literal_weights,
+		                           const uarray& literals,
+		                           std::integral_constant<query_t, R> query)
+		{
+			uword n_seeds = 0;
+			for(uword l : literals)
+				n_seeds += circuit__.occurrence_end(l) - circuit__.occurrence_begin(l);
+			if(4 * n_seeds > n_nodes__)
+			{
+				push_weights(node_weights, literal_weights, query);
+				return;
+			}
+
+			std::priority_queue<uword, uarray, std::greater<uword> > dirty;
+			for(uword l : literals)
+				for(uword i = circuit__.occurrence_begin(l); i < circuit__.occurrence_end(l); ++i)
+					dirty.push(circuit__.occurrence(i));
+
+			uword last = n_nodes__;
+			while(!dirty.empty())
+			{
+				uword index = dirty.top();
+				dirty.pop();
+				if(index == last)
+					continue;
+				last = index;
+
+				double weight = node_weights[index];
+				push_node(node_weights, index, literal_weights, query);
+				if(node_weights[index] == weight)
+					continue;
+
+				for(uword e = circuit__.in_begin(index); e < circuit__.in_end(index); ++e)
+					dirty.push(circuit__.parent(e));
+			}
+		}
+
+		inline void update_weights(dvec& node_weights, const dvec& literal_weights, const uarray& literals)
+		{
+			update_weights(node_weights, literal_weights, literals, traits::to_query<Q>());
+		}
+
+		inline void push_weights(dvec& edge_weights, dvec& node_weights, const dvec& literal_weights)
+		{
+			push_weights(edge_weights, node_weights, literal_weights, traits::to_query<Q>());
+		}
+
+		// Batched pass: literal_weights holds one query per column (n_literals
+		// x K) and node_weights receives one query per column (n_nodes x K).
+		// Queries are processed by blocks of n_block_lanes: each block is
+		// transposed so that its lanes of a node fill one cache line, and the
+		// circuit is traversed once per block (larger blocks no longer fit in
+		// cache on big circuits, and end up slower than separate passes)
+		template<query_t R>
+		inline void push_weights(dmat& node_weights,
+		                         const dmat& literal_weights,
+		                         std::integral_constant<query_t, R> query)
+		{
+			assert(literal_weights.n_rows == n_literals__);
+			const uword n_queries = literal_weights.n_cols;
+			node_weights.set_size(n_nodes__, n_queries);
+			for(uword first = 0; first < n_queries; first += n_block_lanes)
+			{
+				const uword n_lanes = std::min(n_block_lanes, n_queries - first);
+				dmat literal_lanes(n_lanes, n_literals__);
+				for(uword l = 0; l < n_literals__; ++l)
+					for(uword k = 0; k < n_lanes; ++k)
+						literal_lanes(k, l) = literal_weights(l, first + k);
+
+				dmat node_lanes(n_lanes, n_nodes__);
+				traverse([&](uword index)
+				{
+					// Scratch lanes of or nodes, one per thread
+					static thread_local dmat edge_lanes;
+					if(edge_lanes.n_rows != node_lanes.n_rows)
+						edge_lanes.set_size(node_lanes.n_rows, 2);
+
+					switch(circuit__.node_label(index).type)
+					{
+					case 'a':
+						push_and_lanes(node_lanes, index, query);
+						break;
+
+					case 'f':
+						push_constant_lanes(node_lanes, index, false_weight(query));
+						break;
+
+					case 'l':
+						push_literal_lanes(node_lanes, index, literal_lanes);
+						break;
+
+					case 'o':
+						push_or_lanes(node_lanes, edge_lanes, index, literal_lanes, query);
+						break;
+
+					case 't':
+						push_constant_lanes(node_lanes, index, true_weight(query));
+						break;
+					}
+				});
+
+				for(uword k = 0; k < n_lanes; ++k)
+					for(uword index = 0; index < n_nodes__; ++index)
+						node_weights(index, first + k) = node_lanes(k, index);
+			}
+		}
+
+		// Batched integer pass (min-plus or max-plus only), with the same
+		// layout as the batched pass above and blocks of one cache line of
+		// lanes per node
+		template<typename T, query_t R>
+		inline void push_weights(arma::Mat<T>& node_weights,
+		                         const arma::Mat<T>& literal_weights,
+		                         std::integral_constant<query_t, R> query)
+		{
+			static_assert(std::is_integral<T>::value && std::is_signed<T>::value, "signed integer lanes");
+			assert(literal_weights.n_rows == n_literals__);
+			const uword n_block = 64 / sizeof(T);
+			const uword n_queries = literal_weights.n_cols;
+			node_weights.set_size(n_nodes__, n_queries);
+			for(uword first = 0; first < n_queries; first += n_block)
+			{
+				const uword n_lanes = std::min(n_block, n_queries - first);
+				arma::Mat<T> literal_lanes(n_lanes, n_literals__);
+				for(uword l = 0; l < n_literals__; ++l)
+					for(uword k = 0; k < n_lanes; ++k)
+						literal_lanes(k, l) = literal_weights(l, first + k);
+
+				arma::Mat<T> node_lanes(n_lanes, n_nodes__);
+				traverse([&](uword index)
+				{
+					static thread_local arma::Mat<T> edge_lanes;
+					if(edge_lanes.n_rows != node_lanes.n_rows)
+						edge_lanes.set_size(node_lanes.n_rows, 1);
+
+					switch(circuit__.node_label(index).type)
+					{
+					case 'a':
+						push_integer_and_lanes(node_lanes, index, query);
+						break;
+
+					case 'f':
+						push_integer_lanes(node_lanes, index, false_value<T>(query));
+						break;
+
+					case 'l':
+						push_integer_lanes(node_lanes, index, literal_lanes);
+						break;
+
+					case 'o':
+						push_integer_or_lanes(node_lanes, edge_lanes, index, literal_lanes, query);
+						break;
+
+					case 't':
+						push_integer_lanes(node_lanes, index, (T)0);
+						break;
+					}
+				});
+
+				for(uword k = 0; k < n_lanes; ++k)
+					for(uword index = 0; index < n_nodes__; ++index)
+						node_weights(index, first + k) = node_lanes(k, index);
+			}
+		}
+
+		inline void push_weights(dmat& node_weights, const dmat& literal_weights)
+		{
+			push_weights(node_weights, literal_weights, traits::to_query<Q>());
+		}
+
+		// Reverse-mode pass: given the node weights computed by push_weights,
+		// accumulates the partial derivatives of the root weight with respect
+		// to every node and every literal weight, in a single sweep from the
+		// root down to the leaves (flows in the log domain)
+		inline void pull_derivatives(dvec& literal_derivatives,
+		                             dvec& node_derivatives,
+		                             const dvec& node_weights,
+		                             const dvec& literal_weights)
+		{
+			pull_derivatives(literal_derivatives, node_derivatives, node_weights, literal_weights, traits::to_query<Q>());
+		}
+
+		template<query_t R>
+		inline void pull_derivatives(dvec& literal_derivatives,
+		                             dvec& node_derivatives,
+		                             const dvec& node_weights,
+		                             const dvec& literal_weights,
+		                             std::integral_constant<query_t, R> query)
+		{
+			std::vector<double> partials;
+			literal_derivatives.zeros(n_literals__);
+			node_derivatives.zeros(n_nodes__);
+			node_derivatives[n_nodes__ - 1] = 1.0;
+			for(uword index = n_nodes__; index-- > 0;)
 				switch(circuit__.node_label(index).type)
 				{
 				case 'a':
-					push_and_node(node_weights, index);
-					break;
-
-				case 'f':
-					push_false_node(node_weights, index);
+					pull_and_node(node_derivatives, partials, node_weights, index, query);
 					break;
 
 				case 'l':
-					push_literal_node(node_weights, index, literal_weights);
+					pull_literal_node(literal_derivatives, node_derivatives, index, query);
 					break;
 
 				case 'o':
-					push_or_node(edge_weights, node_weights, index, literal_weights);
-					break;
-
-				case 't':
-					push_true_node(node_weights, index);
+					pull_or_node(literal_derivatives, node_derivatives, partials, node_weights, index, literal_weights, query);
 					break;
 				}
 		}
@@ -0,0 +1,379 @@
+// -----------------------------------------------------------------------------
+// Online Combinatorial Optimization
+// dnnf_enumerator__.hpp
+// -----------------------------------------------------------------------------
+
+#ifndef DNNF_ENUMERATOR__HPP
+#define DNNF_ENUMERATOR__HPP
+
+#include "dnnf_circuit__.hpp"
+
+// -----------------------------------------------------------------------------
+// Class Enumerator<DNNF>
+// Lazy model enumeration for dDNNF
+// A model is a derivation of the circuit (every out-edge of an and node, one
+// out-edge of an or node) together with a value of the gap variables of the
+// chosen or-edges; determinism makes all of them distinct. The derivation is
+// kept as a trail of its and nodes and or nodes in preorder, with a cursor at
+// each or node. As in an odometer, the next model advances the last cursor
+// that can still move (the next value of the gap variables, then the next
+// out-edge) and rebuilds the first derivation of everything after it in the
+// trail. Subcircuits without models are never entered, and those with a
+// single model (such as unit literals) take no frame and are never rebuilt,
+// since decomposability keeps their variables apart from the rest; the work
+// per model is then the part of the trail that changes, constant amortized.
+// Models are packed bits, n_words() words per model: bit x is set when
+// variable x is true. Variables that occur nowhere in the circuit are false.
+// -----------------------------------------------------------------------------
+
+template<>
+class Enumerator<DNNF> final
+{
+	public:                 // Traits
+		static const uword n_word_bits = 64;
+
+	protected:              // Traits
+		static const uword no_frame = std::numeric_limits<uword>::max();
+
+		// An and node or an or node of the trail, with the frame of its parent
+		// and the out-edge of the parent it hangs from. The edge of an or node
+		// is its chosen out-edge.
+		struct Frame
+		{
+			uword node;
+			uword parent;
+			uword via;
+			uword edge;
+		};
+
+	protected:              // Attributes
+		const Circuit<DNNF>& circuit__;
+		const uword n_literals__;
+		const uword n_nodes__;
+		const uword n_variables__;
+		const uword n_words__;
+		std::vector<bool> is_live__;
+		std::vector<bool> is_fixed__;
+		uarray open_edges__;
+		Array<Frame> trail__;
+		Array<Frame> pending__;
+		Array<std::uint64_t> model__;
+		bool is_started__;
+		bool is_exhausted__;
+
+	public:                 // Constructors & Destructor
+		Enumerator(const Circuit<DNNF>& circuit) :
+			circuit__(circuit),
+			n_literals__(circuit.n_literals()),
+			n_nodes__(circuit.n_nodes()),
+			n_variables__(circuit.n_variables()),
+			n_words__((circuit.n_variables() + n_word_bits - 1) / n_word_bits),
+			is_live__(circuit.n_nodes(), false),
+			is_fixed__(circuit.n_nodes(), false),
+			open_edges__(circuit.n_edges(), 0),
+			trail__(),
+			pending__(),
+			model__(n_words__, 0),
+			is_started__(false),
+			is_exhausted__(false)
+		{
+			mark_live_nodes();
+			mark_fixed_nodes();
+			reset();
+		}
+
+		~Enumerator()
+		{
+		}
+
+	protected:              // Packed bits
+		inline bool get_bit(const uword x) const
+		{
+			return (model__[x / n_word_bits] >> (x % n_word_bits)) & 1;
+		}
+
+		inline void set_bit(const uword x, const bool value)
+		{
+			const std::uint64_t mask = (std::uint64_t)1 << (x % n_word_bits);
+			if(value)
+				model__[x / n_word_bits] |= mask;
+			else
+				model__[x / n_word_bits] &= ~mask;
+		}
+
+	protected:              // Live nodes
+		// A node is live when it has at least one model
+		inline void mark_live_nodes()
+		{
+			for(uword index = 0; index < n_nodes__; ++index)
+				switch(circuit__.node_label(index).type)
+				{
+				case 'a':
+					is_live__[index] = true;
+					for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+						if(!is_live__[circuit__.child(e)])
+							is_live__[index] = false;
+					break;
+
+				case 'f':
+					is_live__[index] = false;
+					break;
+
+				case 'l':
+				case 't':
+					is_live__[index] = true;
+					break;
+
+				case 'o':
+					is_live__[index] = next_live_edge(index, circuit__.out_begin(index)) < circuit__.out_end(index);
+					break;
+				}
+		}
+
+		// First out-edge from edge on whose child is live (out_end if none)
+		inline uword next_live_edge(const uword index, uword edge) const
+		{
+			while(edge < circuit__.out_end(index) && !is_live__[circuit__.child(edge)])
+				++edge;
+			return edge;
+		}
+
+		// A live node is fixed when it has exactly one model. For the out-edges
+		// of an and node, open_edges__[e] is the first out-edge from e on whose
+		// child is not fixed (out_end if none).
+		inline void mark_fixed_nodes()
+		{
+			for(uword index = 0; index < n_nodes__; ++index)
+			{
+				if(!is_live__[index])
+					continue;
+
+				uword edge;
+				switch(circuit__.node_label(index).type)
+				{
+				case 'a':
+					is_fixed__[index] = true;
+					edge = circuit__.out_end(index);
+					for(uword e = circuit__.out_end(index); e-- > circuit__.out_begin(index);)
+					{
+						if(!is_fixed__[circuit__.child(e)])
+						{
+							is_fixed__[index] = false;
+							edge = e;
+						}
+						open_edges__[e] = edge;
+					}
+					break;
+
+				case 'l':
+				case 't':
+					is_fixed__[index] = true;
+					break;
+
+				case 'o':
+					edge = next_live_edge(index, circuit__.out_begin(index));
+					is_fixed__[index] = is_fixed__[circuit__.child(edge)]
+					                    && circuit__.label_begin(edge) == circuit__.label_end(edge)
+					                    && next_live_edge(index, edge + 1) == circuit__.out_end(index);
+					break;
+				}
+			}
+		}
+
+	protected:              // Gap variables
+		inline void reset_gap(const uword edge)
+		{
+			for(uword i = circuit__.label_begin(edge); i < circuit__.label_end(edge); ++i)
+				set_bit(circuit__.label(i), false);
+		}
+
+		// Binary increment over the gap variables of the edge, which wraps
+		// around to all false (and returns false) after the last value
+		inline bool increment_gap(const uword edge)
+		{
+			for(uword i = circuit__.label_begin(edge); i < circuit__.label_end(edge); ++i)
+			{
+				uword x = circuit__.label(i);
+				if(!get_bit(x))
+				{
+					set_bit(x, true);
+					return true;
+				}
+				set_bit(x, false);
+			}
+			return false;
+		}
+
+	protected:              // Trail
+		// Appends the first derivation of a live node to the trail, in
+		// preorder, and sets the literals and gap variables it fixes. Fixed
+		// nodes only set their literals.
+		void expand(const uword index, const uword parent, const uword via)
+		{
+			pending__.push_back(Frame{index, parent, via, 0});
+			while(!pending__.empty())
+			{
+				Frame frame = pending__.back();
+				pending__.pop_back();
+				switch(circuit__.node_label(frame.node).type)
+				{
+				case 'a':
+					if(!is_fixed__[frame.node])
+					{
+						trail__.push_back(frame);
+						frame.parent = trail__.size() - 1;
+					}
+					for(uword e = circuit__.out_end(frame.node); e-- > circuit__.out_begin(frame.node);)
+						pending__.push_back(Frame{circuit__.child(e), frame.parent, e, 0});
+					break;
+
+				case 'l':
+					set_bit(circuit__.node_label(frame.node).var, circuit__.node_label(frame.node).sgn);
+					break;
+
+				case 'o':
+					frame.edge = next_live_edge(frame.node, circuit__.out_begin(frame.node));
+					reset_gap(frame.edge);
+					if(!is_fixed__[frame.node])
+					{
+						trail__.push_back(frame);
+						frame.parent = trail__.size() - 1;
+					}
+					pending__.push_back(Frame{circuit__.child(frame.edge), frame.parent, frame.edge, 0});
+					break;
+				}
+			}
+		}
+
+		// Drops the trail after the or node of the given frame, whose cursor
+		// has just moved, and rebuilds it: the first derivation of the chosen
+		// child, then that of the remaining open out-edges of every and
+		// ancestor
+		void rebuild(const uword position)
+		{
+			trail__.resize(position + 1);
+			expand(circuit__.child(trail__[position].edge), position, trail__[position].edge);
+			for(uword f = position; trail__[f].parent != no_frame; f = trail__[f].parent)
+			{
+				const uword parent = trail__[f].parent;
+				const uword node = trail__[parent].node;
+				if(circuit__.node_label(node).type != 'a')
+					continue;
+				const uword last = circuit__.out_end(node);
+				for(uword e = trail__[f].via + 1; e < last && (e = open_edges__[e]) < last; ++e)
+					expand(circuit__.child(e), parent, e);
+			}
+		}
+
+		// Moves the last cursor that can still move; false after the last model
+		bool advance()
+		{
+			for(uword position = trail__.size(); position-- > 0;)
+			{
+				Frame& frame = trail__[position];
+				if(circuit__.node_label(frame.node).type != 'o')
+					continue;
+
+				if(!increment_gap(frame.edge))
+				{
+					uword edge = next_live_edge(frame.node, frame.edge + 1);
+					if(edge == circuit__.out_end(frame.node))
+						continue;
+					frame.edge = edge;
+					reset_gap(edge);
+				}
+				rebuild(position);
+				return true;
+			}
+			return false;
+		}
+
+	public:                 // Queries
+		inline uword n_words() const
+		{
+			return n_words__;
+		}
+
+		// The current model (valid after next() has returned true)
+		inline const std::uint64_t* model() const
+		{
+			return model__.data();
+		}
+
+	public:                 // Enumeration
+		// Restarts the enumeration from the first model
+		inline void reset()
+		{
+			trail__.clear();
+			std::fill(model__.begin(), model__.end(), 0);
+			is_started__ = false;
+			is_exhausted__ = !is_live__[n_nodes__ - 1];
+		}
+
+		// Moves to the next model (to the first one on the first call), and
+		// returns false when there is none left
+		inline bool next()
+		{
+			if(is_exhausted__)
+				return false;
+
+			if(!is_started__)
+			{
+				is_started__ = true;
+				expand(n_nodes__ - 1, no_frame, no_frame);
+				return true;
+			}
+
+			is_exhausted__ = !advance();
+			return !is_exhausted__;
+		}
+
+		// Writes the next (at most) n_models models to buffer, n_words() words
+		// per model, and returns the number of models written
+		inline uword enumerate(std::uint64_t* buffer, const uword n_models)
+		{
+			uword n = 0;
+			for(; n < n_models && next(); ++n)
+				std::copy(model__.begin(), model__.end(), buffer + (n * n_words__));
+			return n;
+		}
+
+		// Calls visit(model) on the next (at most) n_models models, and stops
+		// as soon as visit returns false; returns the number of models visited
+		template<typename Visitor>
+		inline uword enumerate(Visitor visit, const uword n_models = std::numeric_limits<uword>::max())
+		{
+			uword n = 0;
+			while(n < n_models && next())
+			{
+				++n;
+				if(!visit((const std::uint64_t*)model__.data()))
+					break;
+			}
+			return n;
+		}
+
+		// The next (at most) n_models models as assignments, one per column
+		inline dmat operator()(const uword n_models)
+		{
+			Array<std::uint64_t> buffer;
+			uword n = 0;
+			enumerate([&](const std::uint64_t* model)
+			{
+				buffer.insert(buffer.end(), model, model + n_words__);
+				++n;
+				return true;
+			}, n_models);
+
+			dmat assignments(n_literals__, n, arma::fill::zeros);
+			for(uword c = 0; c < n; ++c)
+				for(uword x = 0; x < n_variables__; ++x)
+				{
+					assignments(2 * x, c) = (double)((buffer[(c * n_words__) + (x / n_word_bits)] >> (x % n_word_bits)) & 1);
+					assignments((2 * x) + 1, c) = 1.0 - assignments(2 * x, c);
+				}
+			return assignments;
+		}
+};
+
+#endif
@@ -6,135 +6,154 @@
 #ifndef DNNF_LOAD__HPP
 #define DNNF_LOAD__HPP
 
-#include "../fn/set_ops__.hpp"
+// -----------------------------------------------------------------------------
+// Scope operations
+// Variable scopes are only needed while loading, to compute the gap variables
+// of or-edges. They are kept as bitsets, one column of words per node, and
+// discarded once the file is read.
+// -----------------------------------------------------------------------------
+
+const uword scope_bits = 8 * sizeof(uword);
+
+inline uword n_scope_words(const uword n_variables)
+{
+	return (n_variables + scope_bits - 1) / scope_bits;
+}
+
+inline void add_scope(umat& scopes, const uword node, const uword child)
+{
+	uword* target = scopes.colptr(node);
+	const uword* source = scopes.colptr(child);
+	for(uword w = 0; w < scopes.n_rows; ++w)
+		target[w] |= source[w];
+}
+
+inline uvec scope_difference(const umat& scopes, const uword node, const uword child)
+{
+	const uword* a = scopes.colptr(node);
+	const uword* b = scopes.colptr(child);
+	uword n = 0;
+	for(uword w = 0; w < scopes.n_rows; ++w)
+		n += __builtin_popcountll(a[w] & ~b[w]);
+
+	uvec vars(n);
+	uword i = 0;
+	for(uword w = 0; w < scopes.n_rows; ++w)
+		for(uword bits = a[w] & ~b[w]; bits != 0; bits &= bits - 1)
+			vars[i++] = (w * scope_bits) + __builtin_ctzll(bits);
+	return vars;
+}
 
 // -----------------------------------------------------------------------------
 // Load operations
+// Grammar of the .nnf format (one node per line, children precede parents):
+//   nnf <nodes> <edges> <variables>
+//   A <c> <i1> ... <ic>          and node (true node if c = 0)
+//   O <j> <c> <i1> ... <ic>      or node deciding on j (false node if c = 0)
+//   L <lit>                      literal (signed variable, nonzero)
 // -----------------------------------------------------------------------------
 
-template<circuit_t C>
-bool load_nnf_and_node(Circuit<C>& circuit, const std::string& buffer, const uword node)
+inline bool load_nnf_error(const io::tokenizer& tokens, const std::string& text)
 {
-	//cout << io::info("reading and node") << "[" << node << "]: " << buffer << endl;
-
-	std::regex pattern_true {R"(^(\s*[A])(\s+[0]))"};
-	std::smatch match;
-	if(std::regex_match(buffer, match, pattern_true))
-	{
-		circuit.node_label(node).type = 't';
-		return 1;
-	}
+	cerr << io::error("line " + std::to_string(tokens.line()) + ": " + text) << endl;
+	return 0;
+}
 
-	std::regex pattern_and {R"((\s*[A])(\s+\d+)((\s|\d)*))"};
-	if(!std::regex_match(buffer, match, pattern_and))
+template<circuit_t C>
+bool load_nnf_children(Circuit<C>& circuit, umat& scopes, uarray& children, io::tokenizer& tokens, const uword node, const uword n_children)
+{
+	children.resize(n_children);
+	for(uword i = 0; i < n_children; ++i)
 	{
-		cerr << io::error("bad format in " + buffer) << endl;
-		return 0;
+		if(!tokens.read_uword(children[i]))
+			return load_nnf_error(tokens, "bad number of children");
+		if(children[i] >= node)
+			return load_nnf_error(tokens, "child not preceding its parent");
+		circuit.add_edge(node, children[i]);
+		add_scope(scopes, node, children[i]);
 	}
 
-	uword n_children = (uword)std::stoi(match[2]);
-	std::string str_children = match[3];
-	std::regex pattern_child {R"(\d+)"};
-	std::sregex_iterator pos(str_children.cbegin(), str_children.cend(), pattern_child);
-	std::sregex_iterator end;
+	if(!tokens.at_eol())
+		return load_nnf_error(tokens, "bad number of children");
+	return 1;
+}
 
-	uvec vars;
-	uword n = 0;
-	while(pos != end)
-	{
-		uword child = (uword)std::stoi(pos->str());
-		circuit.add_edge(node, child);
-		if(!circuit.node_label(child).vars.empty())
-			vars.insert_rows(vars.n_elem, circuit.node_label(child).vars);
-		pos++;
-		n++;
-	}
+template<circuit_t C>
+bool load_nnf_and_node(Circuit<C>& circuit, umat& scopes, uarray& children, io::tokenizer& tokens, const uword node)
+{
+	uword n_children = 0;
+	if(!tokens.read_keyword("A") || !tokens.read_uword(n_children))
+		return load_nnf_error(tokens, "bad format of and node");
 
-	if(n != n_children)
+	if(n_children == 0)
 	{
-		cerr << io::error("bad number of children in" + buffer) << endl;
-		return 0;
+		circuit.node_label(node).type = 't';
+		return tokens.at_eol() ? 1 : load_nnf_error(tokens, "bad format of true node");
 	}
 
 	circuit.node_label(node).type = 'a';
-	circuit.node_label(node).vars = arma::sort(vars);
-	return 1;
+	return load_nnf_children(circuit, scopes, children, tokens, node, n_children);
 }
 
 template<circuit_t C>
-bool load_nnf_or_node(Circuit<C>& circuit, const std::string& buffer, const uword node)
+bool load_nnf_or_node(Circuit<C>& circuit, umat& scopes, uarray& children, io::tokenizer& tokens, const uword node)
 {
-	//cout << io::info("reading or node") << "[" << node << "]: " << buffer << endl;
+	uword decision = 0;
+	uword n_children = 0;
+	if(!tokens.read_keyword("O") || !tokens.read_uword(decision) || !tokens.read_uword(n_children))
+		return load_nnf_error(tokens, "bad format of or node");
 
-	std::regex pattern_false {R"(^(\s*[O])(\s+0)(\s+[0]))"};
-	std::smatch match;
-	if(std::regex_match(buffer, match, pattern_false))
+	if(n_children == 0)
 	{
 		circuit.node_label(node).type = 'f';
-		return 1;
+		return tokens.at_eol() ? 1 : load_nnf_error(tokens, "bad format of false node");
 	}
 
-	std::regex pattern_or {R"(^(\s*\w+)(\s+\d+)(\s+\d+)(\s+\d+)(\s+\d+))"};
-	if(!std::regex_match(buffer, match, pattern_or))
-	{
-		cerr << io::error("bad format in " + buffer) << endl;
+	circuit.node_label(node).type = 'o';
+	if(!load_nnf_children(circuit, scopes, children, tokens, node, n_children))
 		return 0;
-	}
 
-	uword left = (uword)std::stoi(match[4]);
-	uword right = (uword)std::stoi(match[5]);
-	circuit.add_edge(node, left);
-	circuit.add_edge(node, right);
-	circuit.node_label(node).type = 'o';
-	circuit.node_label(node).vars = set_union(circuit.node_label(left).vars, circuit.node_label(right).vars);
-	circuit.add_edge_label(node, left, set_difference(circuit.node_label(node).vars, circuit.node_label(left).vars));
-	circuit.add_edge_label(node, right, set_difference(circuit.node_label(node).vars, circuit.node_label(right).vars));
+	// Gap variables are only known once every child has been read
+	for(uword child : children)
+	{
+		uvec gap = scope_difference(scopes, node, child);
+		if(!gap.empty())
+			circuit.add_edge_label(node, child, gap);
+	}
 	return 1;
 }
 
 template<circuit_t C>
-bool load_nnf_literal(Circuit<C>& circuit, const std::string& buffer, const uword node)
+bool load_nnf_literal(Circuit<C>& circuit, umat& scopes, io::tokenizer& tokens, const uword node)
 {
-	//cout << io::info("reading literal") << "[" << node << "]: " << buffer << endl;
-
-	std::regex pattern_literal {R"(^(\s*[L])(\s+-?\d+))"};
-	std::smatch match;
-	if(!std::regex_match(buffer, match, pattern_literal))
-	{
-		cerr << io::error("bad format in " + buffer) << endl;
-		return 0;
-	}
+	sword lit = 0;
+	if(!tokens.read_keyword("L") || !tokens.read_sword(lit) || !tokens.at_eol())
+		return load_nnf_error(tokens, "bad format of literal");
 
-	sword lit = (sword)std::stoi(match[2]);
 	if(lit == 0)
-	{
-		cerr << io::error("literal with variable 0 in " + buffer) << endl;
-		return 0;
-	}
+		return load_nnf_error(tokens, "literal with variable 0");
+
+	uword x = std::abs(lit) - 1;
+	if(x >= circuit.n_variables())
+		return load_nnf_error(tokens, "literal out of range");
 
 	circuit.node_label(node).type = 'l';
 	circuit.node_label(node).sgn = ((lit > 0) ? true : false);
-	circuit.node_label(node).vars.set_size(1);
-	circuit.node_label(node).vars[0] = std::abs(lit) - 1;
+	circuit.node_label(node).var = x;
+	scopes(x / scope_bits, node) |= (uword)1 << (x % scope_bits);
 	return 1;
 }
 
-bool load_nnf_header(uword& n_edges, uword& n_nodes, uword& n_variables, const std::string& buffer)
+inline bool load_nnf_header(uword& n_edges, uword& n_nodes, uword& n_variables, io::tokenizer& tokens)
 {
-	//cout << io::info("reading header") << buffer << endl;
+	if(!(tokens.read_keyword("nnf") || tokens.read_keyword("Nnf")))
+		return load_nnf_error(tokens, "bad format of header");
 
-	std::regex pattern_header {R"(^(\s*nnf|Nnf)(\s+\d+)(\s+\d+)(\s+\d+))"};
-	std::smatch match;
-	if(!std::regex_match(buffer, match, pattern_header))
-	{
-		cerr << io::error("bad format in " + buffer) << endl;
-		return 0;
-	}
+	if(!tokens.read_uword(n_nodes) || !tokens.read_uword(n_edges) || !tokens.read_uword(n_variables) || !tokens.at_eol())
+		return load_nnf_error(tokens, "bad format of header");
 
-	n_nodes = (uword)std::stoi(match[2]);
-	n_edges = (uword)std::stoi(match[3]);
-	n_variables = (uword)std::stoi(match[4]);
-	//cout << io::info("header") << "[nodes]: " << n_nodes << " [edges]: " << n_edges << " [variables]: " << n_variables << endl;
+	if(n_nodes == 0)
+		return load_nnf_error(tokens, "empty circuit");
 	return 1;
 }
 
@@ -144,62 +163,60 @@ bool load_nnf_file(Circuit<C>& circuit, const std::string& dataset_name)
 	cout << io::info("loading file") << dataset_name << endl;
 
 	std::string filename = "./dat/" + dataset_name;
-	std::ifstream file;
-	if(!io::check_open(file, filename))
+	io::mapped_file file(filename);
+	if(!file.is_open())
 	{
 		cerr << io::error("cannot open " + filename) << endl;
 		return 0;
 	}
-	file.exceptions(std::ifstream::badbit);
 
-	try
+	io::tokenizer tokens(file.begin(), file.end());
+	uword n_edges = 0;
+	uword n_nodes = 0;
+	uword n_variables = 0;
+	if(!load_nnf_header(n_edges, n_nodes, n_variables, tokens))
+		return 0;
+
+	circuit = Circuit<C>(n_nodes, n_variables);
+	umat scopes(n_scope_words(n_variables), n_nodes, arma::fill::zeros);
+	uarray children;
+
+	uword node = 0;
+	while(tokens.next_line())
 	{
-		std::string buffer;
-		uword node = 0;
-		bool is_first = true;
-		bool is_reading = true;
-		uword n_edges = 0;
-		uword n_nodes = 0;
-		uword n_variables = 0;
-
-		while(is_reading and std::getline(file, buffer))
+		if(tokens.at_eol())
+			continue;
+
+		if(node == n_nodes)
+			return load_nnf_error(tokens, "more nodes than declared");
+
+		bool is_read = false;
+		switch(tokens.peek())
 		{
-			if(is_first)
-			{
-				is_reading = load_nnf_header(n_edges, n_nodes, n_variables, buffer);
-				if(is_reading)
-					circuit = Circuit<C>(n_nodes, n_variables);
-				is_first = false;
-			}
-			else
-			{
-				char head = buffer[0];
-				switch(head)
-				{
-				case 'A':
-					is_reading = load_nnf_and_node(circuit, buffer, node);
-					break;
-
-				case 'L':
-					is_reading = load_nnf_literal(circuit, buffer, node);
-					break;
-
-				case 'O':
-					is_reading = load_nnf_or_node(circuit, buffer, node);
-				}
-				node++;
-			}
+		case 'A':
+			is_read = load_nnf_and_node(circuit, scopes, children, tokens, node);
+			break;
+
+		case 'L':
+			is_read = load_nnf_literal(circuit, scopes, tokens, node);
+			break;
+
+		case 'O':
+			is_read = load_nnf_or_node(circuit, scopes, children, tokens, node);
+			break;
+
+		default:
+			is_read = load_nnf_error(tokens, "unknown node type");
 		}
-	}
-	catch(std::ifstream::failure event)
-	{
-		io::error("unable to read file " + filename + "; cause: " + event.what());
-		return 0;
+
+		if(!is_read)
+			return 0;
+		node++;
 	}
 
-	file.close();
+	if(node != n_nodes)
+		return load_nnf_error(tokens, "fewer nodes than declared");
 	return 1;
 }
 
-
 #endif
@@ -12,6 +12,14 @@
 // Class Marginalizer<DNNF,1>
 // Computes the univariate distribution (literal probabilities) for the dDNNF
 // Literals weights: even index (positive literal) odd index (negative literal)
+// The marginal of a literal l is w_l * (dZ / dw_l) / Z, where Z is the weight of
+// the root; all derivatives are obtained by a single backward pass. Z is taken
+// as w_x * (dZ / dw_x) + w_-x * (dZ / dw_-x), which coincides with the root
+// weight when the circuit is smooth and decomposable, and also absorbs unit
+// literals repeated below the root (as in the tire benchmarks). Variables that do
+// not occur in the circuit are set to true, as in the conditioning method
+// which is kept as a reference. Log-weights (traits::lct) are always handled by
+// the backward pass, which then propagates flows instead of derivatives.
 // -----------------------------------------------------------------------------
 
 template<>
@@ -25,10 +33,12 @@ class Marginalizer<DNNF,1> final : public Counter__<DNNF>
 		using base_type::n_literals__;
 		using base_type::n_nodes__;
 		using base_type::n_variables__;
+		const marginal_t method__;
 
 	public:                 // Constructors & Destructor
-		Marginalizer(const Circuit<DNNF>& circuit) :
-			base_type(circuit)
+		Marginalizer(const Circuit<DNNF>& circuit, const marginal_t method = BACKWARD) :
+			base_type(circuit),
+			method__(method)
 		{
 		}
 
@@ -39,6 +49,7 @@ class Marginalizer<DNNF,1> final : public Counter__<DNNF>
 	protected:              // Autocorrelation functions
 		inline void threaded_marginalize(dvec& marginals, const dvec& dis, const double& partition, const uword x_min, const uword x_max)
 		{
+			const ThreadPool::SerialSection serial;
 			dvec distribution(dis);
 			dvec weights(n_nodes__, arma::fill::zeros);
 
@@ -54,7 +65,27 @@ class Marginalizer<DNNF,1> final : public Counter__<DNNF>
 			}
 		}
 
-		inline dvec marginalize(const dvec& distribution)
+		inline dvec differentiate(const dvec& distribution)
+		{
+			dvec weights(n_nodes__);
+			dvec derivatives;
+			dvec literal_derivatives;
+			dvec marginals(n_literals__);
+			marginalize_literals(marginals, weights, derivatives, literal_derivatives, distribution);
+			return marginals;
+		}
+
+		inline dvec differentiate(const dvec& log_distribution, traits::lct)
+		{
+			dvec weights(n_nodes__);
+			dvec flows;
+			dvec literal_flows;
+			dvec marginals(n_literals__);
+			marginalize_literals(marginals, weights, flows, literal_flows, log_distribution, traits::lct());
+			return marginals;
+		}
+
+		inline dvec condition(const dvec& distribution)
 		{
 			dvec weights(n_nodes__, arma::fill::zeros);
 			dvec marginals(n_literals__, arma::fill::zeros);
@@ -90,6 +121,13 @@ class Marginalizer<DNNF,1> final : public Counter__<DNNF>
 			return marginals;
 		}
 
+		inline dvec marginalize(const dvec& distribution)
+		{
+			if(method__ == CONDITIONING)
+				return condition(distribution);
+			return differentiate(distribution);
+		}
+
 	public:                 // Marginalization operators
 		inline dvec operator()()
 		{
@@ -102,6 +140,168 @@ class Marginalizer<DNNF,1> final : public Counter__<DNNF>
 			assert(distribution.n_elem == n_literals__);
 			return marginalize(distribution);
 		}
+
+		inline dvec operator()(const dvec& log_distribution, traits::lct)
+		{
+			assert(log_distribution.n_elem == n_literals__);
+			return differentiate(log_distribution, traits::lct());
+		}
+
+		// Marginals under evidence: the observed literals get probability 1
+		inline dvec operator()(const dvec& distribution, const Array<Literal>& evidence)
+		{
+			assert(distribution.n_elem == n_literals__);
+			return marginalize(observe(distribution, evidence, traits::ct()));
+		}
+
+		inline dvec operator()(const dvec& log_distribution, const Array<Literal>& evidence, traits::lct)
+		{
+			assert(log_distribution.n_elem == n_literals__);
+			return differentiate(observe(log_distribution, evidence, traits::lct()), traits::lct());
+		}
+};
+
+// -----------------------------------------------------------------------------
+// Class Marginalizer<DNNF,2>
+// Computes the bivariate distribution (pairwise literal probabilities) for the
+// dDNNF, as a dense symmetric matrix P(l_i & l_j) over all pairs of literals.
+// Each variable x is conditioned on (w_-x = 0, or -inf for log-weights) and
+// one backward pass yields P(l | x) for all literals l; then
+// P(x & l) = P(x) P(l | x) and P(-x & l) = P(l) - P(x & l). Variables are
+// processed in parallel.
+// -----------------------------------------------------------------------------
+
+template<>
+class Marginalizer<DNNF,2> final : public Counter__<DNNF>
+{
+	public:                 // Traits
+		using base_type = Counter__<DNNF>;
+
+	protected:              // Attributes
+		using base_type::circuit__;
+		using base_type::n_literals__;
+		using base_type::n_nodes__;
+		using base_type::n_variables__;
+
+	public:                 // Constructors & Destructor
+		Marginalizer(const Circuit<DNNF>& circuit) :
+			base_type(circuit)
+		{
+		}
+
+		~Marginalizer()
+		{
+		}
+
+	protected:              // Autocorrelation functions
+		template<query_t R>
+		inline void threaded_marginalize(dmat& marginals, const dvec& dis, const dvec& univariate, const uword x_min, const uword x_max)
+		{
+			const std::integral_constant<query_t, R> query{};
+			const ThreadPool::SerialSection serial;
+			dvec distribution(dis);
+			dvec weights(n_nodes__);
+			dvec derivatives;
+			dvec literal_derivatives;
+			dvec conditionals(n_literals__);
+
+			for(uword x = x_min; x < x_max; ++x)
+			{
+				double* positive = marginals.colptr(2 * x);
+				double* negative = marginals.colptr((2 * x) + 1);
+				const double px = univariate[2 * x];
+				if(px > 0.0)
+				{
+					double wx = distribution[(2 * x) + 1];
+					distribution[(2 * x) + 1] = false_weight(query);
+					marginalize_literals(conditionals, weights, derivatives, literal_derivatives, distribution, query);
+					distribution[(2 * x) + 1] = wx;
+					for(uword l = 0; l < n_literals__; ++l)
+						positive[l] = px * conditionals[l];
+				}
+				else
+					for(uword l = 0; l < n_literals__; ++l)
+						positive[l] = 0.0;
+
+				for(uword l = 0; l < n_literals__; ++l)
+					negative[l] = std::max(univariate[l] - positive[l], 0.0);
+				negative[2 * x] = 0.0;
+				negative[(2 * x) + 1] = univariate[(2 * x) + 1];
+			}
+		}
+
+		template<query_t R>
+		inline dmat marginalize(const dvec& distribution, std::integral_constant<query_t, R> query)
+		{
+			dvec weights(n_nodes__);
+			dvec derivatives;
+			dvec literal_derivatives;
+			dvec univariate(n_literals__);
+			marginalize_literals(univariate, weights, derivatives, literal_derivatives, distribution, query);
+			dmat marginals(n_literals__, n_literals__, arma::fill::zeros);
+
+			uword n_threads = std::thread::hardware_concurrency();
+			if(n_threads > n_variables__) n_threads = n_variables__;
+			if(n_threads == 0) n_threads = 1;
+			cout << io::info("Number of threads used") << n_threads << endl;
+
+			std::vector<std::future<void> > threads;
+			uword chunk_size = n_variables__ / n_threads;
+			uword x_min = 0;
+			uword x_max = 0;
+			for(uword t = 0; t < n_threads; ++t)
+			{
+				x_min = x_max;
+				x_max = x_min + chunk_size;
+				if(t == n_threads - 1) x_max = n_variables__;
+				threads.push_back(std::async(std::launch::async,
+				                             &Marginalizer::threaded_marginalize<R>,
+				                             this,
+				                             std::ref(marginals),
+				                             std::ref(distribution),
+				                             std::ref(univariate),
+				                             x_min,
+				                             x_max));
+			}
+
+			for(auto & t: threads)
+				t.get();
+
+			// Each column was obtained by conditioning on its own literal;
+			// average with the transpose to remove rounding asymmetries
+			return 0.5 * (marginals + marginals.t());
+		}
+
+	public:                 // Marginalization operators
+		inline dmat operator()()
+		{
+			dvec distribution(n_literals__, arma::fill::ones);
+			return marginalize(distribution, traits::ct());
+		}
+
+		inline dmat operator()(const dvec& distribution)
+		{
+			assert(distribution.n_elem == n_literals__);
+			return marginalize(distribution, traits::ct());
+		}
+
+		inline dmat operator()(const dvec& log_distribution, traits::lct)
+		{
+			assert(log_distribution.n_elem == n_literals__);
+			return marginalize(log_distribution, traits::lct());
+		}
+
+		inline dmat operator()(const dvec& distribution, const Array<Literal>& evidence)
+		{
+			assert(distribution.n_elem == n_literals__);
+			return marginalize(observe(distribution, evidence, traits::ct()), traits::ct());
+		}
+
+		inline dmat operator()(const dvec& log_distribution, const Array<Literal>& evidence, traits::lct)
+		{
+			assert(log_distribution.n_elem == n_literals__);
+			return marginalize(observe(log_distribution, evidence, traits::lct()), traits::lct());
+		}
 };
 
 #endif
@@ -19,23 +19,32 @@ class Optimizer__<DNNF, Q>: public Engine__<DNNF, Q>
 {
 	public:                 // Traits
 		using base_type = Engine__<DNNF, Q>;
-		using Children = arma::SpSubview<uword>;
 
 	protected:              // Attributes
 		using base_type::circuit__;
 		using base_type::n_literals__;
 		using base_type::n_nodes__;
 		using base_type::n_variables__;
+		using Ranked = typename base_type::Ranked;
+		using Ranking = typename base_type::Ranking;
 		dvec objective__;
-		sp_dmat edge_weights__;
+		dvec edge_weights__;
 		dvec node_weights__;
+		Philox generator__;
+		Array<Ranking> node_rankings__;
+		Array<Ranking> edge_rankings__;
+		Array<Ranking> label_rankings__;
 
 	public:                 // Constructors & Destructor
 		Optimizer__(const Circuit<DNNF>& circuit) :
 			base_type(circuit),
 			objective__(circuit.n_literals()),
-			edge_weights__(circuit.n_nodes(), circuit.n_nodes()),
-			node_weights__(circuit.n_nodes())
+			edge_weights__(circuit.n_edges()),
+			node_weights__(circuit.n_nodes()),
+			generator__(Philox::stream()),
+			node_rankings__(),
+			edge_rankings__(),
+			label_rankings__()
 		{
 		}
 
@@ -73,31 +82,27 @@ class Optimizer__<DNNF, Q>: public Engine__<DNNF, Q>
 		}
 
 	protected:              // Protected optimization operations
-		uword choose_child(const uword parent, const Children& children)
+		uword choose_child_edge(const uword parent)
 		{
-			uword best_child = 0;
+			uword best_edge = circuit__.out_begin(parent);
 			double best_score = infinite(traits::to_query<Q>());
-			for(auto p = children.begin(); p != children.end(); ++p)
+			for(uword e = circuit__.out_begin(parent); e < circuit__.out_end(parent); ++e)
 			{
-				uword child = p.col();
-				double score = edge_weights__(parent, child);
+				double score = edge_weights__[e];
 				if(compare(score, best_score, traits::to_query<Q>()) > -1)
 				{
-					best_child = child;
+					best_edge = e;
 					best_score = score;
 				}
 			}
-			return best_child;
+			return best_edge;
 		}
 
-		void choose_free_variables(dvec& assignment,
-		                           const uword parent,
-		                           const uword child)
+		void choose_free_variables(dvec& assignment, const uword edge)
 		{
-			uvec vars = circuit__.edge_label(parent, child);
-			for(uword i = 0; i < vars.size(); ++i)
+			for(uword i = circuit__.label_begin(edge); i < circuit__.label_end(edge); ++i)
 			{
-				uword x = vars[i];
+				uword x = circuit__.label(i);
 				if(compare(objective__[2 * x], objective__[(2 * x) + 1], traits::to_query<Q>()) > -1)
 					assignment[2* x] = 1.0;
 				else
@@ -106,37 +111,183 @@ class Optimizer__<DNNF, Q>: public Engine__<DNNF, Q>
 			}
 		}
 
-		void optimize(dvec& assignment, const uword index)
+		void optimize(dvec& assignment, const uword root)
 		{
-			char type = circuit__.node_label(index).type;
-
-			assert(type != 'f');
+			base_type::descend(root, [&](uword index)
+			{
+				uword edge = choose_child_edge(index);
+				choose_free_variables(assignment, edge);
+				return edge;
+			},
+			[&](uword index)
+			{
+				char type = circuit__.node_label(index).type;
 
-			if(type == 't')
-				return;
+				assert(type != 'f');
 
-			if(type == 'l')
-			{
-				uword x = circuit__.node_label(index).vars[0];
+				if(type != 'l')
+					return;
+				uword x = circuit__.node_label(index).var;
 				assignment[2 * x] = (double)circuit__.node_label(index).sgn;
 				assignment[(2 * x) + 1] = 1.0 - assignment[2 * x];
-				return;
-			}
+			});
+		}
 
-			const arma::SpSubview<uword> children = circuit__.out_edges(index);
+		// Batched counterparts of choose_child_edge and choose_free_variables
+		// for objective c, the or-edge scores being recomputed from the node
+		// weights of the shared pass
+		uword choose_child_edge(const uword parent, const dmat& node_weights, const dmat& objectives, const uword c)
+		{
+			uword best_edge = circuit__.out_begin(parent);
+			double best_score = infinite(traits::to_query<Q>());
+			for(uword e = circuit__.out_begin(parent); e < circuit__.out_end(parent); ++e)
+			{
+				double score = 0;
+				for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+				{
+					uword x = circuit__.label(i);
+					double pos = objectives(2 * x, c);
+					double neg = objectives((2 * x) + 1, c);
+					score += (compare(pos, neg, traits::to_query<Q>()) > 0) ? pos : neg;
+				}
+				score += node_weights(circuit__.child(e), c);
+				if(compare(score, best_score, traits::to_query<Q>()) > -1)
+				{
+					best_edge = e;
+					best_score = score;
+				}
+			}
+			return best_edge;
+		}
 
-			if(type == 'a')
+		void choose_free_variables(dmat& assignments, const dmat& objectives, const uword c, const uword edge)
+		{
+			for(uword i = circuit__.label_begin(edge); i < circuit__.label_end(edge); ++i)
 			{
-				for(auto p = children.begin(); p != children.end(); ++p)
-					optimize(assignment, p.col());
-				return;
+				uword x = circuit__.label(i);
+				if(compare(objectives(2 * x, c), objectives((2 * x) + 1, c), traits::to_query<Q>()) > -1)
+					assignments(2 * x, c) = 1.0;
+				else
+					assignments(2 * x, c) = 0.0;
+				assignments((2 * x) + 1, c) = 1.0 - assignments(2 * x, c);
 			}
+		}
+
+		// Width in bits (16 or 32) of an exact integer evaluation of the given
+		// objectives, scaled by 1 or 2 (for the +-0.5 perturbations of FPL),
+		// or 0 if there is none. No node value can exceed the max-sum of the
+		// absolute literal weights, which is computed in double first, on
+		// scratch buffers so that the weights of the last single-objective
+		// pass are left as they are.
+		inline uword integer_width(const dmat& objectives, double& scale)
+		{
+			dvec magnitudes(n_literals__, arma::fill::zeros);
+			bool is_integral[2] = {true, true};
+			for(uword c = 0; c < objectives.n_cols; ++c)
+				for(uword l = 0; l < n_literals__; ++l)
+				{
+					const double w = objectives(l, c);
+					if(!std::isfinite(w))
+						return 0;
+					is_integral[0] = is_integral[0] && (w == std::round(w));
+					is_integral[1] = is_integral[1] && ((2 * w) == std::round(2 * w));
+					magnitudes[l] = std::max(magnitudes[l], std::fabs(w));
+				}
+			if(!is_integral[1])
+				return 0;
+			scale = is_integral[0] ? 1.0 : 2.0;
+
+			dvec edge_weights(circuit__.n_edges());
+			dvec node_weights(n_nodes__);
+			base_type::push_weights(edge_weights, node_weights, magnitudes, traits::to_query<MAX>());
+			const double bound = scale * node_weights[n_nodes__ - 1];
+			if(bound < std::numeric_limits<std::int16_t>::max() - 1)
+				return 16;
+			if(bound < std::numeric_limits<std::int32_t>::max() - 1)
+				return 32;
+			return 0;
+		}
 
-			if(type == 'o')
+		template<typename T>
+		inline void push_integer_weights(dmat& node_weights, const dmat& objectives, const double scale)
+		{
+			arma::Mat<T> literal_weights(n_literals__, objectives.n_cols);
+			for(uword c = 0; c < objectives.n_cols; ++c)
+				for(uword l = 0; l < n_literals__; ++l)
+					literal_weights(l, c) = (T)std::lround(scale * objectives(l, c));
+
+			arma::Mat<T> integer_weights;
+			base_type::push_weights(integer_weights, literal_weights, traits::to_query<Q>());
+			const T infinite = base_type::template false_value<T>(traits::to_query<Q>());
+			const double false_weight = base_type::false_weight(traits::to_query<Q>());
+			node_weights.set_size(n_nodes__, objectives.n_cols);
+			for(uword c = 0; c < objectives.n_cols; ++c)
+				for(uword index = 0; index < n_nodes__; ++index)
+				{
+					const T value = integer_weights(index, c);
+					node_weights(index, c) = (value == infinite) ? false_weight : (double)value / scale;
+				}
+		}
+
+		// Top-down extraction of the assignment of the given rank at the root.
+		// A task is a node with a rank in its ranking, or an out-edge of an
+		// and node with a rank in the ranking of the prefix ending there.
+		void unrank(dvec& assignment, const uword rank)
+		{
+			struct Task
 			{
-				uword child = choose_child(index, children);
-				choose_free_variables(assignment, index, child);
-				optimize(assignment, child);
+				uword node;
+				uword edge;
+				uword rank;
+				bool is_edge;
+			};
+
+			static thread_local Array<Task> tasks;
+			tasks.clear();
+			tasks.push_back({n_nodes__ - 1, 0, rank, false});
+			while(!tasks.empty())
+			{
+				const Task task = tasks.back();
+				tasks.pop_back();
+				if(task.is_edge)
+				{
+					const Ranked& entry = edge_rankings__[task.edge][task.rank];
+					if(task.edge == circuit__.out_begin(task.node))
+						tasks.push_back({circuit__.child(task.edge), 0, entry.first, false});
+					else
+					{
+						tasks.push_back({task.node, task.edge - 1, entry.first, true});
+						tasks.push_back({circuit__.child(task.edge), 0, entry.second, false});
+					}
+					continue;
+				}
+
+				const uword index = task.node;
+				char type = circuit__.node_label(index).type;
+				if(type == 'l')
+				{
+					uword x = circuit__.node_label(index).var;
+					assignment[2 * x] = (double)circuit__.node_label(index).sgn;
+					assignment[(2 * x) + 1] = 1.0 - assignment[2 * x];
+				}
+				else if(type == 'a' && circuit__.n_children(index) > 0)
+					tasks.push_back({index, circuit__.out_end(index) - 1, task.rank, true});
+				else if(type == 'o')
+				{
+					const Ranked& entry = node_rankings__[index][task.rank];
+					const uword edge = entry.first;
+					uword r = entry.second;
+					for(uword i = circuit__.label_end(edge); i-- > circuit__.label_begin(edge);)
+					{
+						const Ranked& gap = label_rankings__[i][r];
+						uword x = circuit__.label(i);
+						bool is_positive = base_type::is_positive_best(x, objective__, traits::to_query<Q>());
+						assignment[2 * x] = (is_positive == (gap.second == 0)) ? 1.0 : 0.0;
+						assignment[(2 * x) + 1] = 1.0 - assignment[2 * x];
+						r = gap.first;
+					}
+					tasks.push_back({circuit__.child(edge), 0, r, false});
+				}
 			}
 		}
 
@@ -157,11 +308,8 @@ class Optimizer__<DNNF, Q>: public Engine__<DNNF, Q>
 		                     const double& gamma)
 		{
 			assert(obj1.n_elem == n_literals__ && obj2.n_elem == n_literals__);
-			std::random_device rd;
-			mte gen(rd());
-
 			std::bernoulli_distribution ber(gamma);
-			if(ber(gen))
+			if(ber(generator__))
 				objective__ = obj1;
 			else
 				objective__ = obj2;
@@ -172,9 +320,78 @@ class Optimizer__<DNNF, Q>: public Engine__<DNNF, Q>
 			return assignment;
 		}
 
+		// Batched optimization: objectives holds one objective per column. The
+		// min-sum (or max-sum) pass is shared by all columns in lane form, and
+		// the assignments are extracted in parallel, one column per task.
+		// Integral objectives (0/1 losses, or their sums with +-0.5 noise) go
+		// through the integer pass, whose node values are exactly those of
+		// the double pass, so that the assignments are the same.
+		inline dmat optimize(const dmat& objectives)
+		{
+			assert(objectives.n_rows == n_literals__);
+
+			dmat node_weights;
+			double scale = 1.0;
+			switch(integer_width(objectives, scale))
+			{
+			case 16:
+				push_integer_weights<std::int16_t>(node_weights, objectives, scale);
+				break;
+
+			case 32:
+				push_integer_weights<std::int32_t>(node_weights, objectives, scale);
+				break;
+
+			default:
+				base_type::push_weights(node_weights, objectives, traits::to_query<Q>());
+			}
+			dmat assignments(n_literals__, objectives.n_cols, arma::fill::zeros);
+			ThreadPool::instance().parallel_for(objectives.n_cols, [&](uword c)
+			{
+				base_type::descend(n_nodes__ - 1, [&](uword index)
+				{
+					uword edge = choose_child_edge(index, node_weights, objectives, c);
+					choose_free_variables(assignments, objectives, c, edge);
+					return edge;
+				},
+				[&](uword index)
+				{
+					if(circuit__.node_label(index).type != 'l')
+						return;
+					uword x = circuit__.node_label(index).var;
+					assignments(2 * x, c) = (double)circuit__.node_label(index).sgn;
+					assignments((2 * x) + 1, c) = 1.0 - assignments(2 * x, c);
+				});
+			});
+			return assignments;
+		}
+
+		// The k best assignments (fewer if the circuit has fewer models), by
+		// column and in order, with their values. Distinct derivations are
+		// distinct models since the circuit is deterministic and smooth.
+		inline dmat optimize(const dvec& objective, const uword k, dvec& values)
+		{
+			assert(objective.n_elem == n_literals__ && k > 0);
+
+			objective__ = objective;
+			base_type::push_rankings(node_rankings__, edge_rankings__, label_rankings__, objective__, k, traits::to_query<Q>());
+			const Ranking& root = node_rankings__[n_nodes__ - 1];
+			dmat assignments(n_literals__, root.size(), arma::fill::zeros);
+			values.set_size(root.size());
+			dvec assignment(n_literals__);
+			for(uword r = 0; r < root.size(); ++r)
+			{
+				assignment.zeros();
+				unrank(assignment, r);
+				assignments.col(r) = assignment;
+				values[r] = value(assignment, objective__);
+			}
+			return assignments;
+		}
+
 		inline double value(const dvec& assignment, const dvec& objective)
 		{
-			return get_weight(assignment, objective, traits::to_query<Q>());
+			return base_type::get_weight(assignment, objective, traits::to_query<Q>());
 		}
 };
 
@@ -208,6 +425,22 @@ class Optimizer<DNNF, Q> final : public Optimizer__<DNNF, Q>
 		{
 			return base_type::optimize(obj1, obj2, gamma);
 		}
+
+		inline dmat operator()(const dmat& objectives)
+		{
+			return base_type::optimize(objectives);
+		}
+
+		inline dmat operator()(const dvec& objective, const uword k)
+		{
+			dvec values;
+			return base_type::optimize(objective, k, values);
+		}
+
+		inline dmat operator()(const dvec& objective, const uword k, dvec& values)
+		{
+			return base_type::optimize(objective, k, values);
+		}
 };
 
 #endif
@@ -12,6 +12,12 @@
 // Abstract class Sampler__<DNNF>
 // Weighted assignment sampler for DNNF
 // Literals weights: even index (positive literal) odd index (negative literal)
+// Weights can also be given by their logarithms (traits::lct)
+// Both methods draw exact samples top-down. ANCESTRAL walks the cumulative
+// probabilities of the out-edges of an or node; GUMBEL always runs the pass in
+// the log domain, and takes the out-edge of largest log weight plus an
+// independent Gumbel variable (and likewise for gap variables), which never
+// leaves the log domain. Batches are drawn by count splitting in both cases.
 // -----------------------------------------------------------------------------
 
 template<>
@@ -20,25 +26,28 @@ class Sampler__<DNNF>: public Counter__<DNNF>
 	public:
 		// Traits
 		using base_type = Counter__<DNNF>;
-		using Children = arma::SpSubview<uword>;
 
 	protected:
 		// Attributes
 		using base_type::circuit__;
 		using base_type::n_literals__;
 		using base_type::n_nodes__;
-		mte* generator__;
+		const sampling_t method__;
+		Philox generator__;
+		bool is_logarithmic__;
 		dvec distribution__;
-		sp_dmat edge_weights__;
+		dvec edge_weights__;
 		dvec node_weights__;
 
 	public:
 		// Constructors & Destructor
-		Sampler__(const Circuit<DNNF>& circuit) :
+		Sampler__(const Circuit<DNNF>& circuit, const sampling_t method = ANCESTRAL) :
 			base_type(circuit),
-			generator__(nullptr),
+			method__(method),
+			generator__(Philox::stream()),
+			is_logarithmic__(false),
 			distribution__(circuit.n_literals()),
-			edge_weights__(circuit.n_nodes(), circuit.n_nodes()),
+			edge_weights__(circuit.n_edges()),
 			node_weights__(circuit.n_nodes())
 		{
 		}
@@ -49,174 +58,339 @@ class Sampler__<DNNF>: public Counter__<DNNF>
 
 	protected:
 		// Protected sampling operations
-		uword sample_child_variable(const uword parent, const Children& children)
-		{
-			double partition = node_weights__[parent];
-			double prob = 0;
-			auto p = children.begin();
-			uword child = p.col();
-			bool is_chosen = false;
-			while(!is_chosen and p != children.end())
-			{
-				child = p.col();
-				prob += (edge_weights__(parent, child) / partition);
-				std::bernoulli_distribution dis(prob);
-				is_chosen = dis(*generator__);
-				++p;
-			}
-			return child;
+		inline double edge_probability(const uword parent, const uword edge)
+		{
+			if(is_logarithmic__)
+				return std::exp(edge_weights__[edge] - node_weights__[parent]);
+			return edge_weights__[edge] / node_weights__[parent];
 		}
 
-		void sample_free_variables(dvec& assignment, const uword parent, const uword child)
+		inline double literal_probability(const uword x)
 		{
-			uvec vars = circuit__.edge_label(parent, child);
-			for(uword i = 0; i < vars.size(); ++i)
-			{
-				uword x = vars[i];
-				double pos_weight = distribution__[2 * x];
-				double neg_weight = distribution__[(2 * x) + 1];
-				double prob = pos_weight / (neg_weight + pos_weight);
-				std::bernoulli_distribution dis(prob);
-				assignment[2 * x] = (double)dis(*generator__);
-				assignment[(2 * x) + 1] = 1.0 - assignment[2 * x];
-			}
+			double pos_weight = distribution__[2 * x];
+			double neg_weight = distribution__[(2 * x) + 1];
+			if(is_logarithmic__)
+				return 1.0 / (1.0 + std::exp(neg_weight - pos_weight));
+			return pos_weight / (neg_weight + pos_weight);
 		}
 
-		void sample_assignment(dvec& assignment, const uword index)
+		// Forward pass for the given distribution (in the log domain for
+		// GUMBEL)
+		void prepare(const dvec& distribution, const bool is_logarithmic)
 		{
-			char type = circuit__.node_label(index).type;
+			is_logarithmic__ = is_logarithmic || (method__ == GUMBEL);
+			distribution__ = distribution;
+			if(is_logarithmic__ && !is_logarithmic)
+				for(uword l = 0; l < n_literals__; ++l)
+					distribution__[l] = std::log(distribution__[l]);
+			if(is_logarithmic__)
+				base_type::push_weights(edge_weights__, node_weights__, distribution__, traits::lct());
+			else
+				base_type::push_weights(edge_weights__, node_weights__, distribution__);
+		}
 
-			//assert(type != 'f');
+		// Standard Gumbel variable
+		inline double gumbel()
+		{
+			std::exponential_distribution<double> dis(1.0);
+			return -std::log(dis(generator__));
+		}
 
-			if(type == 'f')
-				return;
+		// Gumbel-max over the log weights of the out-edges (edges of weight
+		// zero are never chosen)
+		uword gumbel_child_edge(const uword parent)
+		{
+			uword edge = circuit__.out_begin(parent);
+			double best = -std::numeric_limits<double>::infinity();
+			for(uword e = circuit__.out_begin(parent); e < circuit__.out_end(parent); ++e)
+			{
+				if(edge_weights__[e] == -std::numeric_limits<double>::infinity())
+					continue;
+				const double score = edge_weights__[e] + gumbel();
+				if(score > best)
+				{
+					best = score;
+					edge = e;
+				}
+			}
+			return edge;
+		}
 
-			if(type == 't')
-				return;
+		// One uniform draw per or node, by an inverse CDF walk over the
+		// out-edges (edges of probability zero are never chosen), or a
+		// Gumbel-max under GUMBEL
+		uword sample_child_edge(const uword parent)
+		{
+			if(method__ == GUMBEL)
+				return gumbel_child_edge(parent);
 
-			if(type == 'l')
+			std::uniform_real_distribution<double> dis(0.0, 1.0);
+			double u = dis(generator__);
+			uword edge = circuit__.out_begin(parent);
+			for(uword e = circuit__.out_begin(parent); e < circuit__.out_end(parent); ++e)
 			{
-				uword x = circuit__.node_label(index).vars[0];
-				assignment[2 * x] = (double)circuit__.node_label(index).sgn;
-				assignment[(2 * x) + 1] = 1.0 - assignment[2 * x];
-				return;
+				const double prob = edge_probability(parent, e);
+				if(prob <= 0.0)
+					continue;
+				edge = e;
+				if(u < prob)
+					break;
+				u -= prob;
 			}
+			return edge;
+		}
 
-			const arma::SpSubview<uword> children = circuit__.out_edges(index);
-
-			if(type == 'a')
+		void sample_free_variables(dvec& assignment, const uword edge)
+		{
+			for(uword i = circuit__.label_begin(edge); i < circuit__.label_end(edge); ++i)
 			{
-				for(auto p = children.begin(); p != children.end(); ++p)
-					sample_assignment(assignment, p.col());
-				return;
+				uword x = circuit__.label(i);
+				if(method__ == GUMBEL)
+					assignment[2 * x] = (double)(distribution__[2 * x] + gumbel() > distribution__[(2 * x) + 1] + gumbel());
+				else
+				{
+					std::bernoulli_distribution dis(literal_probability(x));
+					assignment[2 * x] = (double)dis(generator__);
+				}
+				assignment[(2 * x) + 1] = 1.0 - assignment[2 * x];
 			}
+		}
 
-			uword child = sample_child_variable(index, children);
-			sample_free_variables(assignment, index, child);
-			sample_assignment(assignment, child);
+		void sample_assignment(dvec& assignment, const uword root)
+		{
+			base_type::descend(root, [&](uword index)
+			{
+				uword edge = sample_child_edge(index);
+				sample_free_variables(assignment, edge);
+				return edge;
+			},
+			[&](uword index)
+			{
+				if(circuit__.node_label(index).type != 'l')
+					return;
+				uword x = circuit__.node_label(index).var;
+				assignment[2 * x] = (double)circuit__.node_label(index).sgn;
+				assignment[(2 * x) + 1] = 1.0 - assignment[2 * x];
+			});
 		}
 
-		void threaded_multi_sample(dmat& assignments, const uword c_min, const uword c_max)
+		// Splits count samples among the out-edges of an or node, following
+		// a multinomial law drawn as a chain of binomials
+		void split_count(const uword parent, uword count, uarray& edge_counts)
 		{
-			for(uword c = c_min; c < c_max; ++c)
+			double mass = 1.0;
+			const uword last = circuit__.out_end(parent) - 1;
+			for(uword e = circuit__.out_begin(parent); e < last; ++e)
 			{
-				dvec assignment(n_literals__, arma::fill::zeros);
-				sample_assignment(assignment, n_nodes__ - 1);
-				assignments.col(c) = assignment;
+				const double prob = edge_probability(parent, e);
+				std::binomial_distribution<uword> dis(count, (mass > prob) ? prob / mass : 1.0);
+				edge_counts[e] = (count > 0) ? dis(generator__) : 0;
+				count -= edge_counts[e];
+				mass -= prob;
 			}
+			edge_counts[last] = count;
 		}
 
+		// Batched sampling by count splitting. A first top-down sweep pushes
+		// the number of samples reaching each node: copied to the children of
+		// an and node, split among the out-edges of an or node. A second sweep
+		// deals the sample indices along these counts, shuffling them at or
+		// nodes so that every sample picks its edge independently, and sets
+		// the literals and gap variables of each index. Each node is processed
+		// once for the whole batch.
 		void multi_sample(dmat& assignments)
 		{
 			const uword n_samples = assignments.n_cols;
-			uword n_threads = std::thread::hardware_concurrency();
-			if(n_threads > n_samples) n_threads = n_samples;
-			cout << io::info("Number of threads used") << n_threads << endl;
-
-			std::vector<std::future<void> > threads;
-			uword chunk_size = n_samples / n_threads;
-			uword c_min = 0;
-			uword c_max = 0;
-			for(uword t = 0; t < n_threads; ++t)
+			assignments.zeros();
+			if(n_samples == 0)
+				return;
+
+			uarray node_counts(n_nodes__, 0);
+			uarray edge_counts(circuit__.n_edges(), 0);
+			node_counts[n_nodes__ - 1] = n_samples;
+			for(uword index = n_nodes__; index-- > 0;)
 			{
-				c_min = c_max;
-				c_max = c_min + chunk_size;
-				if(t == n_threads - 1) c_max = n_samples;
-				threads.push_back(std::async(std::launch::async,
-				                             &Sampler__::threaded_multi_sample,
-				                             this,
-				                             std::ref(assignments),
-				                             c_min,
-				                             c_max));
+				const uword count = node_counts[index];
+				if(count == 0)
+					continue;
+
+				char type = circuit__.node_label(index).type;
+				if(type == 'o')
+					split_count(index, count, edge_counts);
+				if(type == 'a' || type == 'o')
+					for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+						node_counts[circuit__.child(e)] += (type == 'a') ? count : edge_counts[e];
 			}
 
-			for(auto & t: threads)
-				t.get();
+			uarray offsets(n_nodes__ + 1, 0);
+			for(uword index = 0; index < n_nodes__; ++index)
+				offsets[index + 1] = offsets[index] + node_counts[index];
+			uarray positions(offsets.begin(), offsets.end() - 1);
+			uarray samples(offsets.back());
+			std::iota(samples.begin() + offsets[n_nodes__ - 1], samples.end(), 0);
+
+			for(uword index = n_nodes__; index-- > 0;)
+			{
+				if(node_counts[index] == 0)
+					continue;
+
+				auto first = samples.begin() + offsets[index];
+				auto last = samples.begin() + offsets[index + 1];
+				char type = circuit__.node_label(index).type;
+				if(type == 'l')
+				{
+					uword x = circuit__.node_label(index).var;
+					double sgn = (double)circuit__.node_label(index).sgn;
+					for(auto it = first; it != last; ++it)
+					{
+						assignments(2 * x, *it) = sgn;
+						assignments((2 * x) + 1, *it) = 1.0 - sgn;
+					}
+				}
+				else if(type == 'a')
+				{
+					for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+					{
+						uword child = circuit__.child(e);
+						std::copy(first, last, samples.begin() + positions[child]);
+						positions[child] += node_counts[index];
+					}
+				}
+				else if(type == 'o')
+				{
+					std::shuffle(first, last, generator__);
+					for(uword e = circuit__.out_begin(index); e < circuit__.out_end(index); ++e)
+					{
+						auto next = first + edge_counts[e];
+						for(uword i = circuit__.label_begin(e); i < circuit__.label_end(e); ++i)
+						{
+							uword x = circuit__.label(i);
+							std::bernoulli_distribution dis(literal_probability(x));
+							for(auto it = first; it != next; ++it)
+							{
+								assignments(2 * x, *it) = (double)dis(generator__);
+								assignments((2 * x) + 1, *it) = 1.0 - assignments(2 * x, *it);
+							}
+						}
+						uword child = circuit__.child(e);
+						std::copy(first, next, samples.begin() + positions[child]);
+						positions[child] += edge_counts[e];
+						first = next;
+					}
+				}
+			}
+		}
+
+		void draw(dvec& assignment, const dvec& distribution, const bool is_logarithmic)
+		{
+			prepare(distribution, is_logarithmic);
+			assignment.zeros();
+			sample_assignment(assignment, n_nodes__ - 1);
+		}
+
+		void draw(dmat& assignments, const dvec& distribution, const bool is_logarithmic)
+		{
+			prepare(distribution, is_logarithmic);
+			multi_sample(assignments);
 		}
 
 	public:
 		// Public sampling operations
 		inline dvec sample()
 		{
-			distribution__.ones();
-			dvec assignment(n_literals__, arma::fill::zeros);
-			std::random_device rd;
-			mte gen(rd());
-			generator__ = &gen;
-			base_type::push_weights(edge_weights__, node_weights__, distribution__);
-			sample_assignment(assignment, n_nodes__ - 1);
-			generator__ = nullptr;
+			dvec assignment(n_literals__);
+			draw(assignment, dvec(n_literals__, arma::fill::ones), false);
 			return assignment;
 		}
 
 		inline dvec sample(const dvec& distribution)
 		{
 			assert(distribution.n_elem == n_literals__);
-			std::random_device rd;
-			mte gen(rd());
-			generator__ = &gen;
-
-			distribution__ = distribution;
-
-			dvec assignment(n_literals__, arma::fill::zeros);
-			base_type::push_weights(edge_weights__, node_weights__, distribution__);
-			sample_assignment(assignment, n_nodes__ - 1);
-
-			generator__ = nullptr;
+			dvec assignment(n_literals__);
+			draw(assignment, distribution, false);
 			return assignment;
 		}
 
 		inline dvec sample(const dvec& dis1, const dvec& dis2, const double& gamma)
 		{
 			assert(dis1.n_elem == n_literals__ && dis2.n_elem == n_literals__);
-			std::random_device rd;
-			mte gen(rd());
-			generator__ = &gen;
+			std::bernoulli_distribution ber(gamma);
+			dvec assignment(n_literals__);
+			draw(assignment, ber(generator__) ? dis1 : dis2, false);
+			return assignment;
+		}
+
+		inline dvec sample(const dvec& log_distribution, traits::lct)
+		{
+			assert(log_distribution.n_elem == n_literals__);
+			dvec assignment(n_literals__);
+			draw(assignment, log_distribution, true);
+			return assignment;
+		}
 
+		inline dvec sample(const dvec& log_dis1, const dvec& log_dis2, const double& gamma, traits::lct)
+		{
+			assert(log_dis1.n_elem == n_literals__ && log_dis2.n_elem == n_literals__);
 			std::bernoulli_distribution ber(gamma);
-			if(ber(*generator__))
-				distribution__ = dis1;
-			else
-				distribution__ = dis2;
+			dvec assignment(n_literals__);
+			draw(assignment, ber(generator__) ? log_dis1 : log_dis2, true);
+			return assignment;
+		}
 
-			dvec assignment(n_literals__, arma::fill::zeros);
-			base_type::push_weights(edge_weights__, node_weights__, distribution__);
-			sample_assignment(assignment, n_nodes__ - 1);
+		// Sampling under evidence: the forward pass runs with the masked
+		// weights
+		inline dvec sample(const dvec& distribution, const Array<Literal>& evidence)
+		{
+			assert(distribution.n_elem == n_literals__);
+			dvec assignment(n_literals__);
+			draw(assignment, base_type::observe(distribution, evidence, traits::ct()), false);
+			return assignment;
+		}
 
-			generator__ = nullptr;
+		inline dvec sample(const dvec& log_distribution, const Array<Literal>& evidence, traits::lct)
+		{
+			assert(log_distribution.n_elem == n_literals__);
+			dvec assignment(n_literals__);
+			draw(assignment, base_type::observe(log_distribution, evidence, traits::lct()), true);
 			return assignment;
 		}
 
 		inline dmat sample(const uword n_samples)
 		{
-			distribution__.ones();
-			std::random_device rd;
-			mte gen(rd());
-			generator__ = &gen;
-			push_weights(edge_weights__, node_weights__, distribution__);
 			dmat assignments(n_literals__, n_samples);
-			multi_sample(assignments);
-			generator__ = nullptr;
+			draw(assignments, dvec(n_literals__, arma::fill::ones), false);
+			return assignments;
+		}
+
+		inline dmat sample(const dvec& distribution, const uword n_samples)
+		{
+			assert(distribution.n_elem == n_literals__);
+			dmat assignments(n_literals__, n_samples);
+			draw(assignments, distribution, false);
+			return assignments;
+		}
+
+		inline dmat sample(const dvec& log_distribution, const uword n_samples, traits::lct)
+		{
+			assert(log_distribution.n_elem == n_literals__);
+			dmat assignments(n_literals__, n_samples);
+			draw(assignments, log_distribution, true);
+			return assignments;
+		}
+
+		inline dmat sample(const dvec& distribution, const Array<Literal>& evidence, const uword n_samples)
+		{
+			assert(distribution.n_elem == n_literals__);
+			dmat assignments(n_literals__, n_samples);
+			draw(assignments, base_type::observe(distribution, evidence, traits::ct()), false);
+			return assignments;
+		}
+
+		inline dmat sample(const dvec& log_distribution, const Array<Literal>& evidence, const uword n_samples, traits::lct)
+		{
+			assert(log_distribution.n_elem == n_literals__);
+			dmat assignments(n_literals__, n_samples);
+			draw(assignments, base_type::observe(log_distribution, evidence, traits::lct()), true);
 			return assignments;
 		}
 };
@@ -234,8 +408,8 @@ class Sampler<DNNF> final: public Sampler__<DNNF>
 
 	public:
 		// Constructors & Destructor
-		Sampler(const Circuit<DNNF>& circuit) :
-			base_type(circuit)
+		Sampler(const Circuit<DNNF>& circuit, const sampling_t method = ANCESTRAL) :
+			base_type(circuit, method)
 		{
 		}
 
@@ -260,10 +434,50 @@ class Sampler<DNNF> final: public Sampler__<DNNF>
 			return sample(dis1, dis2, gamma);
 		}
 
+		inline dvec operator()(const dvec& log_distribution, traits::lct)
+		{
+			return sample(log_distribution, traits::lct());
+		}
+
+		inline dvec operator()(const dvec& log_dis1, const dvec& log_dis2, const double& gamma, traits::lct)
+		{
+			return sample(log_dis1, log_dis2, gamma, traits::lct());
+		}
+
 		inline dmat operator()(const uword n_samples)
 		{
 			return sample(n_samples);
 		}
+
+		inline dmat operator()(const dvec& distribution, const uword n_samples)
+		{
+			return sample(distribution, n_samples);
+		}
+
+		inline dmat operator()(const dvec& log_distribution, const uword n_samples, traits::lct)
+		{
+			return sample(log_distribution, n_samples, traits::lct());
+		}
+
+		inline dvec operator()(const dvec& distribution, const Array<Literal>& evidence)
+		{
+			return sample(distribution, evidence);
+		}
+
+		inline dvec operator()(const dvec& log_distribution, const Array<Literal>& evidence, traits::lct)
+		{
+			return sample(log_distribution, evidence, traits::lct());
+		}
+
+		inline dmat operator()(const dvec& distribution, const Array<Literal>& evidence, const uword n_samples)
+		{
+			return sample(distribution, evidence, n_samples);
+		}
+
+		inline dmat operator()(const dvec& log_distribution, const Array<Literal>& evidence, const uword n_samples, traits::lct)
+		{
+			return sample(log_distribution, evidence, n_samples, traits::lct());
+		}
 };
 
 #endif
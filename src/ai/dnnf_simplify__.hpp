@@ -0,0 +1,195 @@
+// -----------------------------------------------------------------------------
+// Online Combinatorial Optimization
+// dnnf_simplify__.hpp
+// -----------------------------------------------------------------------------
+
+#ifndef DNNF_SIMPLIFY__HPP
+#define DNNF_SIMPLIFY__HPP
+
+// -----------------------------------------------------------------------------
+// Simplify operations
+// Rewrites a frozen circuit bottom-up into an equivalent smaller one:
+// - true children of and nodes are dropped, false children make them false
+// - false children of or nodes are dropped (the gaps of the remaining edges
+//   are unchanged, so the scope of the or node is preserved)
+// - gates left with a single child (and an empty gap) are spliced out
+// - structurally identical nodes are merged (hash-consing)
+// - nodes unreachable from the root are removed
+// Each rewritten node is identified by a key: its type followed by its
+// literal, or by its children (with their gap variables for or nodes).
+// -----------------------------------------------------------------------------
+
+const uword simplify_false = std::numeric_limits<uword>::max();
+const uword simplify_true = simplify_false - 1;
+
+inline uword simplify_node(Array<uarray>& keys, std::map<uarray, uword>& ids, uarray&& key)
+{
+	auto p = ids.find(key);
+	if(p != ids.end())
+		return p->second;
+	uword id = keys.size();
+	ids.emplace(key, id);
+	keys.push_back(std::move(key));
+	return id;
+}
+
+template<circuit_t C>
+uword simplify_and_node(const Circuit<C>& circuit, Array<uarray>& keys, std::map<uarray, uword>& ids, const uarray& status, const uword index)
+{
+	uarray children;
+	for(uword e = circuit.out_begin(index); e < circuit.out_end(index); ++e)
+	{
+		uword child = status[circuit.child(e)];
+		if(child == simplify_false)
+			return simplify_false;
+		if(child != simplify_true)
+			children.push_back(child);
+	}
+
+	std::sort(children.begin(), children.end());
+	children.erase(std::unique(children.begin(), children.end()), children.end());
+	if(children.empty())
+		return simplify_true;
+	if(children.size() == 1)
+		return children[0];
+
+	uarray key(1, 'a');
+	key.insert(key.end(), children.begin(), children.end());
+	return simplify_node(keys, ids, std::move(key));
+}
+
+template<circuit_t C>
+uword simplify_or_node(const Circuit<C>& circuit, Array<uarray>& keys, std::map<uarray, uword>& ids, const uarray& status, const uword index)
+{
+	Array<std::pair<uword, uword> > edges;
+	for(uword e = circuit.out_begin(index); e < circuit.out_end(index); ++e)
+	{
+		uword child = status[circuit.child(e)];
+		if(child != simplify_false)
+			edges.push_back(std::make_pair(child, e));
+	}
+
+	if(edges.empty())
+		return simplify_false;
+	if(edges.size() == 1 && circuit.label_begin(edges[0].second) == circuit.label_end(edges[0].second))
+		return edges[0].first;
+
+	std::sort(edges.begin(), edges.end());
+	uarray key(1, 'o');
+	for(auto& edge : edges)
+	{
+		uword child = edge.first;
+		if(child == simplify_true)
+			child = simplify_node(keys, ids, uarray(1, 't'));
+		key.push_back(child);
+		key.push_back(circuit.label_end(edge.second) - circuit.label_begin(edge.second));
+		for(uword i = circuit.label_begin(edge.second); i < circuit.label_end(edge.second); ++i)
+			key.push_back(circuit.label(i));
+	}
+	return simplify_node(keys, ids, std::move(key));
+}
+
+template<circuit_t C>
+void simplify(Circuit<C>& circuit)
+{
+	const uword n_nodes = circuit.n_nodes();
+	const uword n_edges = circuit.n_edges();
+	if(n_nodes == 0)
+		return;
+
+	// Rewrite nodes bottom-up; status maps old nodes to keys or constants
+	Array<uarray> keys;
+	std::map<uarray, uword> ids;
+	uarray status(n_nodes, simplify_false);
+	for(uword index = 0; index < n_nodes; ++index)
+	{
+		const Node& node = circuit.node_label(index);
+		switch(node.type)
+		{
+		case 'a':
+			status[index] = simplify_and_node(circuit, keys, ids, status, index);
+			break;
+
+		case 'f':
+			status[index] = simplify_false;
+			break;
+
+		case 'l':
+			status[index] = simplify_node(keys, ids, {'l', (uword)node.sgn, node.var});
+			break;
+
+		case 'o':
+			status[index] = simplify_or_node(circuit, keys, ids, status, index);
+			break;
+
+		case 't':
+			status[index] = simplify_true;
+			break;
+		}
+	}
+
+	uword root = status[n_nodes - 1];
+	if(root == simplify_false)
+		root = simplify_node(keys, ids, uarray(1, 'f'));
+	if(root == simplify_true)
+		root = simplify_node(keys, ids, uarray(1, 't'));
+
+	// Keep the nodes reachable from the root; keys list their children first
+	Array<bool> is_reachable(root + 1, false);
+	is_reachable[root] = true;
+	for(uword id = root + 1; id-- > 0;)
+	{
+		if(!is_reachable[id])
+			continue;
+		const uarray& key = keys[id];
+		if(key[0] == 'a')
+			for(uword i = 1; i < key.size(); ++i)
+				is_reachable[key[i]] = true;
+		if(key[0] == 'o')
+			for(uword i = 1; i + 1 < key.size(); i += key[i + 1] + 2)
+				is_reachable[key[i]] = true;
+	}
+
+	uarray renumber(root + 1, 0);
+	uword n_kept = 0;
+	for(uword id = 0; id <= root; ++id)
+		if(is_reachable[id])
+			renumber[id] = n_kept++;
+
+	Circuit<C> simplified(n_kept, circuit.n_variables());
+	for(uword id = 0; id <= root; ++id)
+	{
+		if(!is_reachable[id])
+			continue;
+		const uarray& key = keys[id];
+		const uword node = renumber[id];
+		Node& label = simplified.node_label(node);
+		label.type = (char)key[0];
+
+		if(key[0] == 'l')
+		{
+			label.sgn = (bool)key[1];
+			label.var = key[2];
+		}
+
+		if(key[0] == 'a')
+			for(uword i = 1; i < key.size(); ++i)
+				simplified.add_edge(node, renumber[key[i]]);
+
+		if(key[0] == 'o')
+			for(uword i = 1; i + 1 < key.size(); i += key[i + 1] + 2)
+			{
+				if(key[i + 1] == 0)
+					simplified.add_edge(node, renumber[key[i]]);
+				else
+					simplified.add_edge_label(node, renumber[key[i]], uvec(key.data() + i + 2, key[i + 1]));
+			}
+	}
+	simplified.freeze();
+	circuit = std::move(simplified);
+
+	cout << io::info("simplified nodes") << n_nodes << " -> " << circuit.n_nodes() << endl;
+	cout << io::info("simplified edges") << n_edges << " -> " << circuit.n_edges() << endl;
+}
+
+#endif
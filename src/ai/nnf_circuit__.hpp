@@ -9,79 +9,234 @@
 #include "nnf_literal__.hpp"
 #include "nnf_node__.hpp"
 #include "nnf_print__.hpp"
-#include "../fn/mat_find__.hpp"
 
 // -----------------------------------------------------------------------------
 // Class Circuit<NNF>
 // Negation Normal Form Circuit
 // Attributes range from 0 to d-1 (minus one from convention to .cnf and .nnf)
 // The number of literals is 2d i.e. 2 lit per var
+// Nodes are topologically ordered: children precede parents, the root is last
+// The sparse adjacency matrix is only used while loading; freeze() converts it
+// into two compressed sparse row (CSR) layouts: out-edges (children) and
+// in-edges (parents). Out-edges are identified by their position in the CSR.
+// Edge labels (gap variables of or-edges) are staged while loading and packed
+// by freeze() into a single arena addressed by out-edge position.
+// Each literal also indexes the nodes whose weight depends on it directly
+// (its literal nodes, and the or nodes with its variable in a gap), in
+// ascending order; this occurrence index is rebuilt after loading.
+// Nodes are also grouped into levels by height (leaves at level 0, a gate one
+// level above its highest child), so that the nodes of a level can be
+// evaluated in parallel; the level index is rebuilt after loading as well.
+// A frozen circuit may also be mapped from a binary file (see dnnf_binary__),
+// in which case node labels and arrays point into the shared file mapping.
 // -----------------------------------------------------------------------------
 
 template<>
 class Circuit<NNF>
 {
 	public:                 // Traits
-		using EdgeLabels = HashMap<uvec>;
+		using EdgeLabels = Array<std::pair<upair, uvec> >;
 		using NodeLabels = Array<Node>;
 
 	protected:              // Attributes
 		sp_umat adjacency_matrix__;
+		uvec child_offsets__;
+		uvec child_indices__;
+		uvec parent_offsets__;
+		uvec parent_indices__;
+		uvec label_offsets__;
+		uvec label_indices__;
+		uvec occurrence_offsets__;
+		uvec occurrence_indices__;
+		uvec level_offsets__;
+		uvec level_indices__;
 		EdgeLabels edge_labels__;
 		NodeLabels node_labels__;
+		std::shared_ptr<io::mapped_file> mapping__;
+		const Node* nodes__;
+		uword n_nodes__;
 		uword n_variables__;
 
+	public:                 // Friends
+		template<circuit_t D> friend bool load_bin_file(Circuit<D>& circuit, const std::string& dataset_name);
+		template<circuit_t D> friend bool save_bin_file(const Circuit<D>& circuit, const std::string& dataset_name);
+
 	public:                 // Constructors and destructor
 		inline Circuit() :
 			adjacency_matrix__(),
+			child_offsets__(),
+			child_indices__(),
+			parent_offsets__(),
+			parent_indices__(),
+			label_offsets__(),
+			label_indices__(),
+			occurrence_offsets__(),
+			occurrence_indices__(),
+			level_offsets__(),
+			level_indices__(),
 			edge_labels__(),
 			node_labels__(),
+			mapping__(),
+			nodes__(nullptr),
+			n_nodes__(0),
 			n_variables__(0)
 		{
 		}
 
 		inline Circuit(uword n_nodes, uword n_variables) :
 			adjacency_matrix__(n_nodes, n_nodes),
+			child_offsets__(n_nodes + 1, arma::fill::zeros),
+			child_indices__(),
+			parent_offsets__(n_nodes + 1, arma::fill::zeros),
+			parent_indices__(),
+			label_offsets__(),
+			label_indices__(),
+			occurrence_offsets__(),
+			occurrence_indices__(),
+			level_offsets__(),
+			level_indices__(),
 			edge_labels__(),
 			node_labels__(n_nodes, Node()),
+			mapping__(),
+			nodes__(node_labels__.data()),
+			n_nodes__(n_nodes),
 			n_variables__(n_variables)
 		{
 		}
 
+		inline Circuit(const Circuit& other) :
+			adjacency_matrix__(other.adjacency_matrix__),
+			child_offsets__(other.child_offsets__),
+			child_indices__(other.child_indices__),
+			parent_offsets__(other.parent_offsets__),
+			parent_indices__(other.parent_indices__),
+			label_offsets__(other.label_offsets__),
+			label_indices__(other.label_indices__),
+			occurrence_offsets__(other.occurrence_offsets__),
+			occurrence_indices__(other.occurrence_indices__),
+			level_offsets__(other.level_offsets__),
+			level_indices__(other.level_indices__),
+			edge_labels__(other.edge_labels__),
+			node_labels__(other.node_labels__),
+			mapping__(other.mapping__),
+			nodes__(other.is_mapped() ? other.nodes__ : node_labels__.data()),
+			n_nodes__(other.n_nodes__),
+			n_variables__(other.n_variables__)
+		{
+		}
+
+		inline Circuit(Circuit&& other) :
+			adjacency_matrix__(std::move(other.adjacency_matrix__)),
+			child_offsets__(std::move(other.child_offsets__)),
+			child_indices__(std::move(other.child_indices__)),
+			parent_offsets__(std::move(other.parent_offsets__)),
+			parent_indices__(std::move(other.parent_indices__)),
+			label_offsets__(std::move(other.label_offsets__)),
+			label_indices__(std::move(other.label_indices__)),
+			occurrence_offsets__(std::move(other.occurrence_offsets__)),
+			occurrence_indices__(std::move(other.occurrence_indices__)),
+			level_offsets__(std::move(other.level_offsets__)),
+			level_indices__(std::move(other.level_indices__)),
+			edge_labels__(std::move(other.edge_labels__)),
+			node_labels__(std::move(other.node_labels__)),
+			mapping__(std::move(other.mapping__)),
+			nodes__(is_mapped() ? other.nodes__ : node_labels__.data()),
+			n_nodes__(other.n_nodes__),
+			n_variables__(other.n_variables__)
+		{
+		}
+
 	public:                 // Queries
-		inline const arma::SpSubview<uword> in_edges(uword index) const
+		inline uword child(uword edge) const
 		{
-			return adjacency_matrix__.col(index);
+			return child_indices__[edge];
+		}
+
+		inline uvec children(uword x) const
+		{
+			return uvec(child_indices__.memptr() + child_offsets__[x], n_children(x));
 		}
 
 		inline bool is_edge(uword parent, uword child) const
 		{
-			return (adjacency_matrix__(parent, child) == 1);
+			auto first = child_indices__.cbegin() + child_offsets__[parent];
+			auto last = child_indices__.cbegin() + child_offsets__[parent + 1];
+			return std::binary_search(first, last, child);
+		}
+
+		inline uword in_begin(uword x) const
+		{
+			return parent_offsets__[x];
+		}
+
+		inline uword in_end(uword x) const
+		{
+			return parent_offsets__[x + 1];
+		}
+
+		inline uword label(uword position) const
+		{
+			return label_indices__[position];
+		}
+
+		inline uword label_begin(uword edge) const
+		{
+			return label_offsets__[edge];
+		}
+
+		inline uword label_end(uword edge) const
+		{
+			return label_offsets__[edge + 1];
+		}
+
+		inline uword occurrence(uword position) const
+		{
+			return occurrence_indices__[position];
+		}
+
+		inline uword occurrence_begin(uword literal) const
+		{
+			return occurrence_offsets__[literal];
+		}
+
+		inline uword occurrence_end(uword literal) const
+		{
+			return occurrence_offsets__[literal + 1];
 		}
 
-		inline arma::uvec children(uword x) const
+		inline uword level_begin(uword level) const
 		{
-			return find_cols(adjacency_matrix__.row(x));
+			return level_offsets__[level];
 		}
 
-		inline const uvec& edge_label(uword parent, uword child) const
+		inline uword level_end(uword level) const
 		{
-			return edge_labels__.at((parent * n_nodes()) + child);
+			return level_offsets__[level + 1];
 		}
 
-		inline const EdgeLabels& edge_labels() const
+		inline uword level_node(uword position) const
 		{
-			return edge_labels__;
+			return level_indices__[position];
+		}
+
+		inline uword n_levels() const
+		{
+			return (level_offsets__.n_elem > 0) ? level_offsets__.n_elem - 1 : 0;
 		}
 
 		inline uword n_children(uword x) const
 		{
-			return adjacency_matrix__.row(x).n_nonzero;
+			return child_offsets__[x + 1] - child_offsets__[x];
 		}
 
 		inline uword n_edges() const
 		{
-			return adjacency_matrix__.n_nonzero;
+			return child_indices__.n_elem;
+		}
+
+		inline uword n_labels() const
+		{
+			return label_indices__.n_elem;
 		}
 
 		inline uword n_literals() const
@@ -89,14 +244,19 @@ class Circuit<NNF>
 			return 2 * n_variables__;
 		}
 
+		inline bool is_mapped() const
+		{
+			return mapping__ != nullptr;
+		}
+
 		inline uword n_nodes() const
 		{
-			return node_labels__.size();
+			return n_nodes__;
 		}
 
 		inline uword n_parents(uword x) const
 		{
-			return adjacency_matrix__.col(x).n_nonzero;
+			return parent_offsets__[x + 1] - parent_offsets__[x];
 		}
 
 		inline const uword& n_variables() const
@@ -106,22 +266,97 @@ class Circuit<NNF>
 
 		inline const Node& node_label(uword index) const
 		{
-			return node_labels__[index];
+			return nodes__[index];
+		}
+
+		inline uword out_begin(uword x) const
+		{
+			return child_offsets__[x];
+		}
+
+		inline uword out_end(uword x) const
+		{
+			return child_offsets__[x + 1];
+		}
+
+		inline uword parent(uword edge) const
+		{
+			return parent_indices__[edge];
 		}
 
-		inline const NodeLabels& node_labels() const
+		inline uvec parents(uword x) const
 		{
-			return node_labels__;
+			return uvec(parent_indices__.memptr() + parent_offsets__[x], n_parents(x));
 		}
 
-		inline const arma::SpSubview<uword> out_edges(uword index) const
+	protected:              // Indexing
+		// Two passes over the nodes (count, then fill); an or node is listed
+		// once per literal even if its variable occurs in several gaps
+		template<typename F>
+		inline void visit_occurrences(F visit) const
 		{
-			return adjacency_matrix__.row(index);
+			uvec last(n_variables__);
+			last.fill(n_nodes__);
+			for(uword index = 0; index < n_nodes__; ++index)
+			{
+				const Node& node = nodes__[index];
+				if(node.type == 'l')
+					visit(node.sgn ? 2 * node.var : (2 * node.var) + 1, index);
+				else if(node.type == 'o')
+					for(uword i = label_offsets__[child_offsets__[index]]; i < label_offsets__[child_offsets__[index + 1]]; ++i)
+					{
+						uword x = label_indices__[i];
+						if(last[x] == index)
+							continue;
+						last[x] = index;
+						visit(2 * x, index);
+						visit((2 * x) + 1, index);
+					}
+			}
 		}
 
-		inline arma::uvec parents(uword x) const
+		inline void index_occurrences()
 		{
-			return find_rows(adjacency_matrix__.col(x));
+			occurrence_offsets__.zeros(n_literals() + 1);
+			visit_occurrences([this](uword literal, uword)
+			{
+				occurrence_offsets__[literal + 1]++;
+			});
+
+			for(uword l = 0; l < n_literals(); ++l)
+				occurrence_offsets__[l + 1] += occurrence_offsets__[l];
+
+			uvec cursor = occurrence_offsets__;
+			occurrence_indices__.set_size(occurrence_offsets__[n_literals()]);
+			visit_occurrences([this, &cursor](uword literal, uword index)
+			{
+				occurrence_indices__[cursor[literal]++] = index;
+			});
+		}
+
+		// Counting sort of the nodes by height; within a level, nodes remain
+		// in ascending order
+		inline void index_levels()
+		{
+			uvec heights(n_nodes__, arma::fill::zeros);
+			uword n_levels = (n_nodes__ > 0) ? 1 : 0;
+			for(uword index = 0; index < n_nodes__; ++index)
+			{
+				for(uword e = child_offsets__[index]; e < child_offsets__[index + 1]; ++e)
+					heights[index] = std::max(heights[index], heights[child_indices__[e]] + 1);
+				n_levels = std::max(n_levels, heights[index] + 1);
+			}
+
+			level_offsets__.zeros(n_levels + 1);
+			for(uword index = 0; index < n_nodes__; ++index)
+				level_offsets__[heights[index] + 1]++;
+			for(uword h = 0; h < n_levels; ++h)
+				level_offsets__[h + 1] += level_offsets__[h];
+
+			uvec cursor = level_offsets__;
+			level_indices__.set_size(n_nodes__);
+			for(uword index = 0; index < n_nodes__; ++index)
+				level_indices__[cursor[heights[index]]++] = index;
 		}
 
 	public:                 // Transformations
@@ -133,27 +368,99 @@ class Circuit<NNF>
 		inline void add_edge_label(uword parent, uword child, const uvec& label)
 		{
 			adjacency_matrix__(parent, child) = 1;
-			edge_labels__.insert(std::make_pair((parent * n_nodes()) + child, label));
+			edge_labels__.push_back(std::make_pair(upair(parent, child), label));
 		}
 
-		inline uvec& edge_label(uword parent, uword child)
+		inline void freeze()
 		{
-			return edge_labels__.at((parent * n_nodes()) + child);
+			const uword n = n_nodes();
+			child_offsets__.zeros(n + 1);
+			parent_offsets__.zeros(n + 1);
+			child_indices__.set_size(adjacency_matrix__.n_nonzero);
+			parent_indices__.set_size(adjacency_matrix__.n_nonzero);
+
+			// Column-major traversal: parents of each child come in ascending order
+			uword e = 0;
+			for(auto p = adjacency_matrix__.begin(); p != adjacency_matrix__.end(); ++p)
+			{
+				child_offsets__[p.row() + 1]++;
+				parent_offsets__[p.col() + 1]++;
+				parent_indices__[e++] = p.row();
+			}
+
+			for(uword x = 0; x < n; ++x)
+			{
+				child_offsets__[x + 1] += child_offsets__[x];
+				parent_offsets__[x + 1] += parent_offsets__[x];
+			}
+
+			// Children of each parent also come in ascending order
+			uvec cursor = child_offsets__;
+			for(auto p = adjacency_matrix__.begin(); p != adjacency_matrix__.end(); ++p)
+				child_indices__[cursor[p.row()]++] = p.col();
+
+			// Gap variables of each edge are packed in edge order
+			uvec edges(edge_labels__.size());
+			label_offsets__.zeros(child_indices__.n_elem + 1);
+			for(uword l = 0; l < edge_labels__.size(); ++l)
+			{
+				const upair& link = edge_labels__[l].first;
+				auto first = child_indices__.cbegin() + child_offsets__[link.first];
+				auto last = child_indices__.cbegin() + child_offsets__[link.first + 1];
+				edges[l] = std::lower_bound(first, last, link.second) - child_indices__.cbegin();
+				label_offsets__[edges[l] + 1] = edge_labels__[l].second.n_elem;
+			}
+
+			for(uword e = 0; e < child_indices__.n_elem; ++e)
+				label_offsets__[e + 1] += label_offsets__[e];
+
+			label_indices__.set_size(label_offsets__[child_indices__.n_elem]);
+			for(uword l = 0; l < edge_labels__.size(); ++l)
+			{
+				const uvec& vars = edge_labels__[l].second;
+				std::copy(vars.cbegin(), vars.cend(), label_indices__.begin() + label_offsets__[edges[l]]);
+			}
+
+			adjacency_matrix__.reset();
+			edge_labels__.clear();
+			edge_labels__.shrink_to_fit();
+			index_occurrences();
+			index_levels();
 		}
 
-		inline EdgeLabels& edge_labels()
+		// The records of a mapped circuit are in its private (copy-on-write)
+		// mapping, hence writable as well
+		inline Node& node_label(uword index)
 		{
-			return edge_labels__;
+			return const_cast<Node&>(nodes__[index]);
 		}
 
-		inline Node& node_label(uword index)
+		inline Circuit& operator=(const Circuit& other)
 		{
-			return node_labels__[index];
+			Circuit copy(other);
+			return *this = std::move(copy);
 		}
 
-		inline NodeLabels& node_labels()
+		inline Circuit& operator=(Circuit&& other)
 		{
-			return node_labels__;
+			adjacency_matrix__ = std::move(other.adjacency_matrix__);
+			child_offsets__ = std::move(other.child_offsets__);
+			child_indices__ = std::move(other.child_indices__);
+			parent_offsets__ = std::move(other.parent_offsets__);
+			parent_indices__ = std::move(other.parent_indices__);
+			label_offsets__ = std::move(other.label_offsets__);
+			label_indices__ = std::move(other.label_indices__);
+			occurrence_offsets__ = std::move(other.occurrence_offsets__);
+			occurrence_indices__ = std::move(other.occurrence_indices__);
+			level_offsets__ = std::move(other.level_offsets__);
+			level_indices__ = std::move(other.level_indices__);
+			edge_labels__ = std::move(other.edge_labels__);
+			node_labels__ = std::move(other.node_labels__);
+			mapping__ = std::move(other.mapping__);
+			nodes__ = is_mapped() ? other.nodes__ : node_labels__.data();
+			n_nodes__ = other.n_nodes__;
+			n_variables__ = other.n_variables__;
+			return *this;
 		}
 
 	public:                 // IO
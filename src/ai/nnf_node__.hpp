@@ -9,6 +9,8 @@
 // -----------------------------------------------------------------------------
 // Class Node
 // Node descriptor of an NNF Circuit
+// Variable scopes are not stored: only literals keep their variable
+// Nodes are trivially copyable so that they can be mapped from binary files
 // -----------------------------------------------------------------------------
 
 class Node
@@ -16,51 +18,16 @@ class Node
 	public:                 // Attributes
 		bool sgn;
 		char type;
-		uvec vars;
+		uword var;
 
-	public:                 // Constructors & Destructor
+	public:                 // Constructors
 		inline Node() :
 			sgn(1),
 			type('a'),
-			vars()
+			var(0)
 		{
 		}
 
-		inline Node(const Node& other) :
-			sgn(other.sgn),
-			type(other.type),
-			vars(other.vars)
-		{
-		}
-
-		inline Node(Node&& other) :
-			sgn(std::move(other.sgn)),
-			type(std::move(other.type)),
-			vars(std::move(other.vars))
-		{
-		}
-
-		virtual ~Node()
-		{
-		}
-
-	public:                 // Transformations
-		Node& operator=(const Node& other)
-		{
-			sgn = other.sgn;
-			type = other.type;
-			vars = other.vars;
-			return *this;
-		}
-
-		Node& operator=(Node&& other)
-		{
-			sgn = std::move(other.sgn);
-			type = std::move(other.type);
-			vars = std::move(other.vars);
-			return *this;
-		}
-
 	public:                 // IO
 		friend ostream & operator <<(ostream & output, const Node& node)
 		{
@@ -98,9 +65,9 @@ class Node
 			else
 				output << "-1";
 
-			output << " [vars]: ";
-			for(uword x = 0; x < node.vars.n_elem; ++x)
-				output << node.vars[x] << " ";
+			if(node.type == 'l')
+				output << " [var]: " << node.var;
+			output << " ";
 			return output;
 		}
 };
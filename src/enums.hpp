@@ -62,6 +62,27 @@ enum circuit_t
 	SDD     // Sentential Decision Diagram
 };
 
+// -----------------------------------------------------------------------------
+// Circuit traversal executors
+// -----------------------------------------------------------------------------
+
+enum executor_t
+{
+	SEQUENTIAL,     // One node after the other, in topological order
+	LEVELS,         // Level-synchronous parallel evaluation
+	TASKS           // Task DAG with dependency counters and work stealing
+};
+
+// -----------------------------------------------------------------------------
+// Marginalization methods
+// -----------------------------------------------------------------------------
+
+enum marginal_t
+{
+	BACKWARD,       // Reverse-mode differentiation (one forward and one backward pass)
+	CONDITIONING    // Conditioning on each variable (one forward pass per variable)
+};
+
 // -----------------------------------------------------------------------------
 // Queries
 // -----------------------------------------------------------------------------
@@ -70,8 +91,19 @@ enum query_t
 {
 	CO,     // Coherence testing
 	CT,     // Model counting
+	LCT,    // Model counting in the log domain
 	MAX,    // Maximization
 	MIN     // Minimization
 };
 
+// -----------------------------------------------------------------------------
+// Sampling methods
+// -----------------------------------------------------------------------------
+
+enum sampling_t
+{
+	ANCESTRAL,      // Top-down draws by inverse CDF along a sum-product pass
+	GUMBEL          // Top-down Gumbel-max draws along a log-domain pass
+};
+
 #endif
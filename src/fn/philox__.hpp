@@ -0,0 +1,111 @@
+// -----------------------------------------------------------------------------
+// Online Combinatorial Optimization
+// philox__.hpp
+// -----------------------------------------------------------------------------
+
+#ifndef PHILOX__HPP
+#define PHILOX__HPP
+
+// -----------------------------------------------------------------------------
+// Class Philox
+// Counter-based random generator Philox4x32-10 (Salmon et al., 2011)
+// The key is the experiment seed, and the upper half of the counter is a
+// stream number, so that every stream is an independent sequence that costs
+// no state beyond its counter. Streams are handed out in order by stream(),
+// which makes the results of a run depend on the seed only.
+// Models UniformRandomBitGenerator, for use with the <random> distributions.
+// -----------------------------------------------------------------------------
+
+class Philox
+{
+	public:                 // Traits
+		using result_type = std::uint32_t;
+
+	protected:              // Attributes
+		std::uint32_t key__[2];
+		std::uint32_t counter__[4];
+		std::uint32_t block__[4];
+		uword position__;
+
+	public:                 // Constructors & Destructor
+		Philox(const std::uint64_t seed, const std::uint64_t stream) :
+			key__{(std::uint32_t)seed, (std::uint32_t)(seed >> 32)},
+			counter__{0, 0, (std::uint32_t)stream, (std::uint32_t)(stream >> 32)},
+			block__{0, 0, 0, 0},
+			position__(4)
+		{
+		}
+
+		~Philox()
+		{
+		}
+
+	protected:              // Block function
+		inline static void mulhilo(const std::uint32_t a, const std::uint32_t b, std::uint32_t& hi, std::uint32_t& lo)
+		{
+			const std::uint64_t product = (std::uint64_t)a * (std::uint64_t)b;
+			hi = (std::uint32_t)(product >> 32);
+			lo = (std::uint32_t)product;
+		}
+
+		inline void generate()
+		{
+			std::uint32_t k0 = key__[0];
+			std::uint32_t k1 = key__[1];
+			std::uint32_t c[4] = {counter__[0], counter__[1], counter__[2], counter__[3]};
+			for(uword round = 0; round < 10; ++round)
+			{
+				std::uint32_t hi0, lo0, hi1, lo1;
+				mulhilo(0xD2511F53, c[0], hi0, lo0);
+				mulhilo(0xCD9E8D57, c[2], hi1, lo1);
+				c[0] = hi1 ^ c[1] ^ k0;
+				c[1] = lo1;
+				c[2] = hi0 ^ c[3] ^ k1;
+				c[3] = lo0;
+				k0 += 0x9E3779B9;
+				k1 += 0xBB67AE85;
+			}
+			for(uword i = 0; i < 4; ++i)
+				block__[i] = c[i];
+
+			if(++counter__[0] == 0)
+				++counter__[1];
+		}
+
+	public:                 // Generation
+		inline static constexpr result_type min()
+		{
+			return 0;
+		}
+
+		inline static constexpr result_type max()
+		{
+			return std::numeric_limits<result_type>::max();
+		}
+
+		inline result_type operator()()
+		{
+			if(position__ == 4)
+			{
+				generate();
+				position__ = 0;
+			}
+			return block__[position__++];
+		}
+
+	public:                 // Streams
+		// Experiment seed, drawn once from the system unless set (option -s)
+		inline static std::uint64_t& seed()
+		{
+			static std::uint64_t value = ((std::uint64_t)std::random_device()() << 32) | std::random_device()();
+			return value;
+		}
+
+		inline static Philox stream()
+		{
+			static std::atomic<std::uint64_t> next_stream(0);
+			return Philox(seed(), next_stream++);
+		}
+};
+
+#endif
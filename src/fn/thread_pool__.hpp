@@ -0,0 +1,305 @@
+// -----------------------------------------------------------------------------
+// Online Combinatorial Optimization
+// thread_pool__.hpp
+// -----------------------------------------------------------------------------
+
+#ifndef THREAD_POOL__HPP
+#define THREAD_POOL__HPP
+
+// -----------------------------------------------------------------------------
+// Class ThreadPool
+// Persistent pool of workers for fork-join loops (one instance per process)
+// parallel_for(n, task) runs task(0), ..., task(n - 1) on the workers and on
+// the calling thread, and returns once all of them are done. Tasks are handed
+// out dynamically through an atomic counter.
+// A loop runs inline in the calling thread when the pool is already busy, or
+// when the calling thread is inside a SerialSection (used by callers that are
+// themselves multi-threaded, so that they never oversubscribe the cores).
+// -----------------------------------------------------------------------------
+
+class ThreadPool
+{
+	public:                 // Serial sections
+		class SerialSection
+		{
+			protected:      // Attributes
+				bool was_serial__;
+
+			public:         // Constructors & Destructor
+				SerialSection() :
+					was_serial__(is_serial())
+				{
+					is_serial() = true;
+				}
+
+				~SerialSection()
+				{
+					is_serial() = was_serial__;
+				}
+
+				SerialSection(const SerialSection&) = delete;
+				SerialSection& operator=(const SerialSection&) = delete;
+		};
+
+	protected:              // Attributes
+		Array<std::thread> workers__;
+		std::mutex mutex__;
+		std::mutex busy__;
+		std::condition_variable wake__;
+		std::condition_variable done__;
+		std::function<void(uword)> task__;
+		std::atomic<uword> next_task__;
+		uword n_tasks__;
+		uword n_pending__;
+		uword generation__;
+		bool is_stopping__;
+
+	public:                 // Constructors & Destructor
+		explicit ThreadPool(const uword n_workers) :
+			workers__(),
+			next_task__(0),
+			n_tasks__(0),
+			n_pending__(0),
+			generation__(0),
+			is_stopping__(false)
+		{
+			for(uword w = 0; w < n_workers; ++w)
+				workers__.emplace_back(&ThreadPool::work, this);
+		}
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex__);
+				is_stopping__ = true;
+			}
+			wake__.notify_all();
+			for(auto& worker : workers__)
+				worker.join();
+		}
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+	protected:              // Workers
+		inline static bool& is_serial()
+		{
+			static thread_local bool flag = false;
+			return flag;
+		}
+
+		inline void run_tasks()
+		{
+			for(uword t = next_task__++; t < n_tasks__; t = next_task__++)
+				task__(t);
+		}
+
+		inline void work()
+		{
+			uword generation = 0;
+			while(true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex__);
+					wake__.wait(lock, [&]{ return is_stopping__ || generation__ != generation; });
+					if(is_stopping__)
+						return;
+					generation = generation__;
+				}
+
+				run_tasks();
+
+				{
+					std::lock_guard<std::mutex> lock(mutex__);
+					if(--n_pending__ == 0)
+						done__.notify_one();
+				}
+			}
+		}
+
+	public:                 // Queries
+		// Executor used by the inference engines unless set otherwise
+		inline static executor_t& default_executor()
+		{
+			static executor_t executor = LEVELS;
+			return executor;
+		}
+
+		inline static ThreadPool& instance()
+		{
+			static ThreadPool pool(std::max<uword>(std::thread::hardware_concurrency(), 1) - 1);
+			return pool;
+		}
+
+		inline uword n_threads() const
+		{
+			return workers__.size() + 1;
+		}
+
+	public:                 // Parallel loops
+		inline void parallel_for(const uword n_tasks, const std::function<void(uword)>& task)
+		{
+			if(n_tasks <= 1 || workers__.empty() || is_serial() || !busy__.try_lock())
+			{
+				for(uword t = 0; t < n_tasks; ++t)
+					task(t);
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex__);
+				task__ = task;
+				n_tasks__ = n_tasks;
+				next_task__ = 0;
+				n_pending__ = workers__.size();
+				++generation__;
+			}
+			wake__.notify_all();
+
+			run_tasks();
+
+			{
+				std::unique_lock<std::mutex> lock(mutex__);
+				done__.wait(lock, [&]{ return n_pending__ == 0; });
+				task__ = nullptr;
+			}
+			busy__.unlock();
+		}
+};
+
+// -----------------------------------------------------------------------------
+// Class TaskDeque
+// Work-stealing deque of node indices owned by one worker (Chase and Lev, 2005,
+// with the memory orders of Le et al., 2013). The owner pushes and pops at the
+// bottom without locking (last in, first out, which keeps chains hot in
+// cache), while the other workers steal from the top with a compare-and-swap.
+// The ring doubles when full; retired rings are kept until the deque is
+// destroyed, since a thief may still be reading from them.
+// -----------------------------------------------------------------------------
+
+class TaskDeque
+{
+	protected:              // Rings
+		class Ring
+		{
+			protected:      // Attributes
+				const std::int64_t mask__;
+				std::unique_ptr<std::atomic<uword>[]> slots__;
+
+			public:         // Constructors & Destructor
+				explicit Ring(const std::int64_t capacity) :
+					mask__(capacity - 1),
+					slots__(new std::atomic<uword>[capacity])
+				{
+				}
+
+			public:         // Accessors
+				inline std::int64_t capacity() const
+				{
+					return mask__ + 1;
+				}
+
+				inline uword get(const std::int64_t i) const
+				{
+					return slots__[i & mask__].load(std::memory_order_relaxed);
+				}
+
+				inline void put(const std::int64_t i, const uword task)
+				{
+					slots__[i & mask__].store(task, std::memory_order_relaxed);
+				}
+		};
+
+	protected:              // Attributes
+		std::atomic<std::int64_t> top__;
+		char separator__[64];
+		std::atomic<std::int64_t> bottom__;
+		std::atomic<Ring*> ring__;
+		Array<std::unique_ptr<Ring> > rings__;
+
+	public:                 // Constructors & Destructor
+		explicit TaskDeque(const uword capacity = 64) :
+			top__(0),
+			bottom__(0),
+			ring__(nullptr),
+			rings__()
+		{
+			std::int64_t size = 1;
+			while(size < (std::int64_t)capacity)
+				size *= 2;
+			rings__.emplace_back(new Ring(size));
+			ring__.store(rings__.back().get(), std::memory_order_relaxed);
+		}
+
+		~TaskDeque()
+		{
+		}
+
+		TaskDeque(const TaskDeque&) = delete;
+		TaskDeque& operator=(const TaskDeque&) = delete;
+
+	protected:              // Growth (owner only)
+		inline Ring* grow(const Ring* ring, const std::int64_t top, const std::int64_t bottom)
+		{
+			rings__.emplace_back(new Ring(2 * ring->capacity()));
+			Ring* larger = rings__.back().get();
+			for(std::int64_t i = top; i < bottom; ++i)
+				larger->put(i, ring->get(i));
+			ring__.store(larger, std::memory_order_release);
+			return larger;
+		}
+
+	public:                 // Operations
+		// Owner only
+		inline void push(const uword task)
+		{
+			const std::int64_t bottom = bottom__.load(std::memory_order_relaxed);
+			const std::int64_t top = top__.load(std::memory_order_acquire);
+			Ring* ring = ring__.load(std::memory_order_relaxed);
+			if(bottom - top > ring->capacity() - 1)
+				ring = grow(ring, top, bottom);
+			ring->put(bottom, task);
+			std::atomic_thread_fence(std::memory_order_release);
+			bottom__.store(bottom + 1, std::memory_order_relaxed);
+		}
+
+		// Owner only
+		inline bool pop(uword& task)
+		{
+			const std::int64_t bottom = bottom__.load(std::memory_order_relaxed) - 1;
+			Ring* ring = ring__.load(std::memory_order_relaxed);
+			bottom__.store(bottom, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			std::int64_t top = top__.load(std::memory_order_relaxed);
+			if(top > bottom)
+			{
+				bottom__.store(bottom + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			task = ring->get(bottom);
+			if(top < bottom)
+				return true;
+
+			// Last task: race against the thieves
+			const bool is_won = top__.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom__.store(bottom + 1, std::memory_order_relaxed);
+			return is_won;
+		}
+
+		// Any worker; fails when the deque is empty or another thief won
+		inline bool steal(uword& task)
+		{
+			std::int64_t top = top__.load(std::memory_order_acquire);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const std::int64_t bottom = bottom__.load(std::memory_order_acquire);
+			if(top >= bottom)
+				return false;
+
+			Ring* ring = ring__.load(std::memory_order_acquire);
+			task = ring->get(top);
+			return top__.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		}
+};
+
+#endif
@@ -40,7 +40,10 @@ namespace io
 		feedback,
 		learner,
 		trials,
-		projections
+		projections,
+		binary,
+		executor,
+		seed
 	};
 
 	// Output plots
@@ -64,8 +67,12 @@ namespace io
 	class subsection;
 	class error;
 	class warning;
+	class mapped_file;
+	class tokenizer;
 }
 
 #include "io/io__.hpp"
+#include "io/mapped_file__.hpp"
+#include "io/tokenizer__.hpp"
 
 #endif
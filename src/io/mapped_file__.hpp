@@ -0,0 +1,104 @@
+// -----------------------------------------------------------------------------
+//
+// Online Combinatorial Optimization
+// mapped_file__.hpp
+//
+// -----------------------------------------------------------------------------
+
+#ifndef MAPPED_FILE__HPP
+#define MAPPED_FILE__HPP
+
+// -----------------------------------------------------------------------------
+// Memory-mapped files
+// Read-only view of a whole file, unmapped on destruction
+// A private mapping is copy-on-write: its pages are shared with the page cache
+// until written, and writes stay in the process (the file is never modified)
+// -----------------------------------------------------------------------------
+
+namespace io
+{
+	class mapped_file
+	{
+		protected:
+			const char* data__;
+			uword size__;
+			int descriptor__;
+
+		public:
+			explicit mapped_file(const std::string& filename, const bool is_private = false) :
+				data__(nullptr),
+				size__(0),
+				descriptor__(::open(filename.c_str(), O_RDONLY))
+			{
+				if(descriptor__ < 0)
+					return;
+
+				struct stat status;
+				if(::fstat(descriptor__, &status) < 0)
+				{
+					close();
+					return;
+				}
+
+				size__ = (uword) status.st_size;
+				if(size__ == 0)
+				{
+					data__ = "";
+					return;
+				}
+
+				void* address = is_private ? ::mmap(nullptr, size__, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor__, 0)
+				                           : ::mmap(nullptr, size__, PROT_READ, MAP_SHARED, descriptor__, 0);
+				if(address == MAP_FAILED)
+				{
+					close();
+					return;
+				}
+				::madvise(address, size__, MADV_SEQUENTIAL);
+				data__ = static_cast<const char*>(address);
+			}
+
+			mapped_file(const mapped_file&) = delete;
+			mapped_file& operator=(const mapped_file&) = delete;
+
+			~mapped_file()
+			{
+				close();
+			}
+
+		protected:
+			void close()
+			{
+				if(data__ != nullptr && size__ > 0)
+					::munmap(const_cast<char*>(data__), size__);
+				if(descriptor__ >= 0)
+					::close(descriptor__);
+				data__ = nullptr;
+				size__ = 0;
+				descriptor__ = -1;
+			}
+
+		public:
+			inline bool is_open() const
+			{
+				return data__ != nullptr;
+			}
+
+			inline const char* begin() const
+			{
+				return data__;
+			}
+
+			inline const char* end() const
+			{
+				return data__ + size__;
+			}
+
+			inline uword size() const
+			{
+				return size__;
+			}
+	};
+}
+
+#endif
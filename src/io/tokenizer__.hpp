@@ -0,0 +1,140 @@
+// -----------------------------------------------------------------------------
+//
+// Online Combinatorial Optimization
+// tokenizer__.hpp
+//
+// -----------------------------------------------------------------------------
+
+#ifndef TOKENIZER__HPP
+#define TOKENIZER__HPP
+
+// -----------------------------------------------------------------------------
+// Line-oriented tokenizer
+// Reads blank-separated keywords and integers from a character range without
+// allocating; tokens never span lines and lines are counted from 1
+// -----------------------------------------------------------------------------
+
+namespace io
+{
+	class tokenizer
+	{
+		protected:
+			const char* pos__;
+			const char* end__;
+			uword line__;
+
+		public:
+			tokenizer(const char* first, const char* last) :
+				pos__(first),
+				end__(last),
+				line__(1)
+			{
+			}
+
+		protected:
+			inline static bool is_blank(char c)
+			{
+				return c == ' ' || c == '\t' || c == '\r';
+			}
+
+			inline static bool is_digit(char c)
+			{
+				return c >= '0' && c <= '9';
+			}
+
+			inline bool is_separated() const
+			{
+				return pos__ == end__ || is_blank(*pos__) || *pos__ == '\n';
+			}
+
+		public:
+			inline uword line() const
+			{
+				return line__;
+			}
+
+			inline void skip_blanks()
+			{
+				while(pos__ != end__ && is_blank(*pos__))
+					++pos__;
+			}
+
+			// True if only blanks remain on the current line
+			inline bool at_eol()
+			{
+				skip_blanks();
+				return pos__ == end__ || *pos__ == '\n';
+			}
+
+			// Moves to the start of the next line; false at the end of input
+			inline bool next_line()
+			{
+				while(pos__ != end__ && *pos__ != '\n')
+					++pos__;
+				if(pos__ == end__)
+					return false;
+				++pos__;
+				++line__;
+				return pos__ != end__;
+			}
+
+			inline char peek()
+			{
+				skip_blanks();
+				return (pos__ == end__) ? '\n' : *pos__;
+			}
+
+			inline bool read_keyword(const char* keyword)
+			{
+				skip_blanks();
+				const char* p = pos__;
+				while(*keyword != '\0')
+				{
+					if(p == end__ || *p != *keyword)
+						return false;
+					++p;
+					++keyword;
+				}
+				const char* q = pos__;
+				pos__ = p;
+				if(!is_separated())
+				{
+					pos__ = q;
+					return false;
+				}
+				return true;
+			}
+
+			inline bool read_uword(uword& value)
+			{
+				skip_blanks();
+				if(pos__ == end__ || !is_digit(*pos__))
+					return false;
+				const char* p = pos__;
+				value = 0;
+				while(p != end__ && is_digit(*p))
+					value = (10 * value) + (uword)(*p++ - '0');
+				pos__ = p;
+				return is_separated();
+			}
+
+			inline bool read_sword(sword& value)
+			{
+				skip_blanks();
+				bool is_negative = (pos__ != end__ && *pos__ == '-');
+				if(is_negative)
+				{
+					++pos__;
+					if(pos__ == end__ || !is_digit(*pos__))
+						return false;
+				}
+				uword magnitude = 0;
+				if(!read_uword(magnitude))
+					return false;
+				value = is_negative ? -(sword)magnitude : (sword)magnitude;
+				return true;
+			}
+	};
+}
+
+#endif
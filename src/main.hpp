@@ -23,8 +23,10 @@ class Application
 		std::bitset<4> inflags__;
 		std::bitset<2> outflags__;
 		uword n_trials__;
+		bool is_converting__;
 		bool is_helping__;
 		bool is_running__;
+		bool is_simplifying__;
 
 	protected:
 		void init(int argc, char** argv);
@@ -36,6 +38,7 @@ class Application
 		}
 
 		// Executions
+		bool convert();
 		bool help();
 		bool run();
 };
@@ -45,13 +48,15 @@ class Application
 // -----------------------------------------------------------------------------
 
 Application::Application(int argc, char** argv) :
-	input__(5),
+	input__(8),
 	output__(2),
 	inflags__(),
 	outflags__(),
 	n_trials__(0),
+	is_converting__(false),
 	is_helping__(false),
-	is_running__(false)
+	is_running__(false),
+	is_simplifying__(false)
 {
 	init(argc, argv);
 }
@@ -60,20 +65,36 @@ bool Application::help()
 {
 	cout << "OCO version 1.0" << endl;
 	cout << "oco is a framework for online combinatorial optimization" << endl;
-	cout << io::title("Usage: oco [-h] -c <circuit> -l <learner> -f <feedback> -t <trials> [-p <projections>] [--regrets] [--runtimes]") << endl;
+	cout << io::title("Usage: oco [-h] -c <circuit> -l <learner> -f <feedback> -t <trials> [-p <projections>] [-e <executor>] [-s <seed>] [--simplify] [--regrets] [--runtimes]") << endl;
+	cout << io::title("       oco convert <circuit> <binary> [--simplify]") << endl;
 	cout << io::subsection("Positional arguments") << endl;
-	cout << io::info("-c <ircuit>") << "compiled circuit in .nnf format" << endl;
+	cout << io::info("-c <ircuit>") << "compiled circuit in .nnf or binary format" << endl;
 	cout << io::info("-l <learner>") << "online learner in {fpl, exp_exp, omd_l2, omd_ure}" << endl;
 	cout << io::info("-f <feedback>") << "environment feedback in {full, semibandit, bandit}" << endl;
 	cout << io::info("-t <trials>") << "number of trials" << endl;
 	cout << io::subsection("Optional arguments") << endl;
 	cout << io::info("-p <projections>") << "max number of approximation steps in Bregman projection" << endl;
+	cout << io::info("-e <executor>") << "circuit traversal in {sequential, levels, tasks}" << endl;
+	cout << io::info("-s <seed>") << "seed of the random generators, for reproducible runs" << endl;
+	cout << io::info("--simplify") << "simplifies the circuit after loading" << endl;
 	cout << io::info("--regrets") << "outputs regrets plot" << endl;
 	cout << io::info("--runtimes") << "outputs runtimes plot" << endl;
 	cout << io::info("-h, --help") << "show this help message and exit" << endl;
+	cout << io::subsection("Conversion") << endl;
+	cout << io::info("convert") << "precompiles a .nnf circuit into the binary format" << endl;
 	return true;
 }
 
+bool Application::convert()
+{
+	Circuit<DNNF> dnnf(input__[io::circuit]);
+	if(dnnf.n_variables() == 0)
+		return false;
+	if(is_simplifying__)
+		dnnf.simplify();
+	return dnnf.save(input__[io::binary]);
+}
+
 void Application::init(int argc, char** argv)
 {
 	if(argc == 1 or io::is_member(std::string(argv[1]), {"--help", "-h"}))
@@ -82,6 +103,19 @@ void Application::init(int argc, char** argv)
 		return;
 	}
 
+	if(std::string(argv[1]) == "convert")
+	{
+		is_converting__ = (argc == 4 || argc == 5);
+		if(is_converting__)
+		{
+			input__[io::circuit] = argv[2];
+			input__[io::binary] = argv[3];
+			is_simplifying__ = (argc == 5 && std::string(argv[4]) == "--simplify");
+		}
+		return;
+	}
+
+	bool is_valid = true;
 	for(int i = 1; i < argc; i++)
 	{
 		// Positional
@@ -89,7 +123,7 @@ void Application::init(int argc, char** argv)
 		if(choice == "-c" && i < argc - 1)
 		{
 			input__[io::circuit] = argv[i+1];
-			inflags__[io::circuit] = io::is_member(io::find_extension(input__[io::circuit]), {"nnf","sdd"});
+			inflags__[io::circuit] = io::is_member(io::find_extension(input__[io::circuit]), {"nnf","sdd","bin"});
 		}
 		else if(choice == "-f" && i < argc - 1)
 		{
@@ -111,24 +145,56 @@ void Application::init(int argc, char** argv)
 		{
 			input__[io::projections] = argv[i+1];
 		}
+		else if(choice == "-e" && i < argc - 1)
+		{
+			input__[io::executor] = argv[i+1];
+			if(input__[io::executor] == "sequential")
+				ThreadPool::default_executor() = SEQUENTIAL;
+			else if(input__[io::executor] == "levels")
+				ThreadPool::default_executor() = LEVELS;
+			else if(input__[io::executor] == "tasks")
+				ThreadPool::default_executor() = TASKS;
+			else
+			{
+				cerr << io::error("unknown executor " + input__[io::executor]) << endl;
+				is_valid = false;
+			}
+		}
+		else if(choice == "-s" && i < argc - 1)
+		{
+			input__[io::seed] = argv[i+1];
+			if(io::is_number(input__[io::seed]))
+				Philox::seed() = std::stoull(input__[io::seed]);
+			else
+			{
+				cerr << io::error("invalid seed " + input__[io::seed]) << endl;
+				is_valid = false;
+			}
+		}
+		else if(choice == "--simplify")
+			is_simplifying__ = true;
 		else if(choice == "--regrets")
 			outflags__[io::regrets] = 1;
 		else if(choice == "--runtimes")
 			outflags__[io::runtimes] = 1;
 	}
-	is_running__ = inflags__.all();
+	is_running__ = inflags__.all() && is_valid;
 }
 
 bool Application::run()
 {
 	if(is_helping__)
 		return help();
+	if(is_converting__)
+		return convert();
 	if(!is_running__)
 		return false;
 
 	if(input__[io::feedback] == "full")
 	{
 		Circuit<DNNF> dnnf(input__[io::circuit]);
+		if(is_simplifying__)
+			dnnf.simplify();
 		uword n_objectives = std::max((uword)1, n_trials__ / 10);
 		uword n_trials = (uword) std::stoi(input__[io::trials]);
 		Environment<DNNF,FULL> env(dnnf,n_objectives,n_trials);
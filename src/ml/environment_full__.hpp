@@ -57,12 +57,14 @@ class Environment<C,FULL>
 			objectives__ = ones - assignments;
 		}
 
+		// The best fixed assignment in hindsight minimizes the average
+		// objective, hence the total one: the sum of the 0/1 objectives is
+		// integral, which the batched minimizer evaluates in integers
 		inline void set_target()
 		{
-			dvec avg_objective = arma::sum(objectives__, 1);
-			avg_objective /= n_objectives__;
+			dmat sum_objective = arma::sum(objectives__, 1);
 			Minimizer<C> minimizer(circuit__);
-			target__ = minimizer(avg_objective);
+			target__ = minimizer(sum_objective);
 		}
 
 
@@ -9,6 +9,7 @@
 // -----------------------------------------------------------------------------
 // Class Learner<circuit_t C, EXPEXP, FULL>
 // a.k.a Hedge for decisions compiled in nnf circuits
+// Predictions are drawn by the given sampling method (see Sampler__<DNNF>)
 // -----------------------------------------------------------------------------
 
 template<circuit_t C>
@@ -20,14 +21,16 @@ class Learner<C,EXPEXP,FULL>
 		const Environment<C,FULL>& environment__;
 		const uword n_literals__;
 		const uword n_trials__;
+		const sampling_t method__;
 
 	public:
 		// Constructors & Destructor
-		Learner(const Circuit<C>& circuit, const Environment<C,FULL>& environment, uword n_trials) :
+		Learner(const Circuit<C>& circuit, const Environment<C,FULL>& environment, uword n_trials, const sampling_t method = ANCESTRAL) :
 			circuit__(circuit),
 			environment__(environment),
 			n_literals__(circuit.n_literals()),
-			n_trials__(n_trials)
+			n_trials__(n_trials),
+			method__(method)
 		{
 		}
 
@@ -36,22 +39,24 @@ class Learner<C,EXPEXP,FULL>
 		}
 
 	protected:
-		inline void set_hyperparameters(double& partition)
+		// The distribution is kept in the log domain, so that the weights
+		// exp(-eta * cumloss) never underflow on long horizons; the number of
+		// models is counted exactly
+		inline void set_hyperparameters(double& log_partition)
 		{
 			Counter<C> count(circuit__);
-			partition = count();
+			log_partition = Counter<C>::log_count(count.count_models());
 		}
 
-		inline void update_distribution(dvec& distribution, const dvec& cumloss, const double& eta)
+		inline void update_distribution(dvec& log_distribution, const dvec& cumloss, const double& eta)
 		{
 			for(uword x = 0; x < n_literals__; x++)
-				distribution[x] = exp(-eta * cumloss[x]);
+				log_distribution[x] = -eta * cumloss[x];
 		}
 
-		inline void update_hyperparameters(double& eta, const double& partition, const uword& trial)
+		inline void update_hyperparameters(double& eta, const double& log_partition, const uword& trial)
 		{
-			double logN = log(partition);
-			eta = sqrt(logN / (2.0 * (double) trial));
+			eta = sqrt(log_partition / (2.0 * (double) trial));
 		}
 
 		inline void update_loss(dvec& cumloss, const dvec& objective)
@@ -66,23 +71,23 @@ class Learner<C,EXPEXP,FULL>
 			cout << io::subsection("Initializing learner") << endl;
 			double cum_regret = 0;
 			double eta = 0;
-			double partition = 0;
-			set_hyperparameters(partition);
-			cout << io::info("partition") << partition << endl;
+			double log_partition = 0;
+			set_hyperparameters(log_partition);
+			cout << io::info("log partition") << log_partition << endl;
 
-			Sampler<C> sample(circuit__);
-			dvec distribution(n_literals__, arma::fill::ones);
+			Sampler<C> sample(circuit__, method__);
+			dvec log_distribution(n_literals__, arma::fill::zeros);
 			dvec cumloss(n_literals__, arma::fill::zeros);
 
 			cout << io::subsection("Learning") << endl;
 			for(uword trial = 1; trial <= n_trials__; trial++)
 			{
 				// Update hyperparameters
-				update_hyperparameters(eta, partition, trial);
+				update_hyperparameters(eta, log_partition, trial);
 				cout << io::info("Updating hyperparameters") << trial << " [eta]: " << eta << endl;
 
 				// Sample a model
-				dvec prediction = sample(distribution);
+				dvec prediction = sample(log_distribution, traits::lct());
 				//cout << io::info("Prediction") << trial << endl << prediction << endl;
 
 				// Get response
@@ -97,8 +102,8 @@ class Learner<C,EXPEXP,FULL>
 				update_loss(cumloss, objective);
 
 				// Update distribution
-				update_distribution(distribution, cumloss, eta);
-				//cout << io::info("Updating distribution") << trial << endl << distribution << endl;
+				update_distribution(log_distribution, cumloss, eta);
+				//cout << io::info("Updating distribution") << trial << endl << log_distribution << endl;
 			}
 			cum_regret /= (double) n_trials__;
 			cout << io::info("Cumulative regret") << cum_regret << endl;
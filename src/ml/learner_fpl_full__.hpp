@@ -9,6 +9,9 @@
 // -----------------------------------------------------------------------------
 // Class Learner<circuit_t C, FPL, FULL>
 // a.k.a FPL for decisions compiled in nnf circuits
+// With n_draws > 1, each trial follows several independent perturbations,
+// minimized together in one batched pass, and predicts their average (whose
+// loss is the expected loss of a leader drawn uniformly among them)
 // -----------------------------------------------------------------------------
 
 template<circuit_t C>
@@ -20,16 +23,18 @@ class Learner<C, FPL, FULL>
 		const Environment<C,FULL>& environment__;
 		const uword n_literals__;
 		const uword n_trials__;
-		mte* generator__;
+		const uword n_draws__;
+		Philox generator__;
 
 	public:
 		// Constructors & Destructor
-		Learner(const Circuit<C>& circuit, const Environment<C,FULL>& environment, uword n_trials) :
+		Learner(const Circuit<C>& circuit, const Environment<C,FULL>& environment, uword n_trials, uword n_draws = 1) :
 			circuit__(circuit),
 			environment__(environment),
 			n_literals__(circuit.n_literals()),
 			n_trials__(n_trials),
-			generator__(nullptr)
+			n_draws__(n_draws),
+			generator__(Philox::stream())
 		{
 		}
 
@@ -38,16 +43,17 @@ class Learner<C, FPL, FULL>
 		}
 
 	protected:
-		inline void update_perturbation(dvec& perturbation)
+		inline void update_perturbation(dmat& perturbations)
 		{
-			for(uword x = 0; x < n_literals__; x++)
-			{
-				std::bernoulli_distribution dis(0.5);
-				if(dis(*generator__))
-					perturbation(x) += 0.5;
-				else
-					perturbation(x) -= 0.5;
-			}
+			for(uword d = 0; d < n_draws__; d++)
+				for(uword x = 0; x < n_literals__; x++)
+				{
+					std::bernoulli_distribution dis(0.5);
+					if(dis(generator__))
+						perturbations(x, d) += 0.5;
+					else
+						perturbations(x, d) -= 0.5;
+				}
 		}
 
 	public:
@@ -57,24 +63,24 @@ class Learner<C, FPL, FULL>
 			cout << io::subsection("Initializing learner") << endl;
 			Minimizer<C> minimize(circuit__);
 
-			std::random_device rd;
-			mte gen(rd());
-			generator__ = &gen;
-			dvec perturbation(n_literals__, arma::fill::zeros);
+			dmat perturbations(n_literals__, n_draws__, arma::fill::zeros);
 
 			dvec cum_loss(n_literals__, arma::fill::zeros);
-			dvec per_loss(n_literals__, arma::fill::zeros);
+			dmat per_losses(n_literals__, n_draws__, arma::fill::zeros);
 			double cum_regret = 0;
 
 			cout << io::subsection("Learning") << endl;
 			for(uword trial = 1; trial <= n_trials__; trial++)
 			{
 				// Upodate perturbation
-				update_perturbation(perturbation);
-				per_loss = cum_loss + perturbation;
+				update_perturbation(perturbations);
+				for(uword d = 0; d < n_draws__; d++)
+					per_losses.col(d) = cum_loss + perturbations.col(d);
 
-				// Follow the Perturbed Leader
-				dvec prediction = minimize(per_loss);
+				// Follow the Perturbed Leader (the losses are integral up to
+				// the +-0.5 perturbations, so the batched pass is exact in
+				// integers)
+				dvec prediction = arma::sum(minimize(per_losses), 1) / (double) n_draws__;
 
 				// Get response
 				dvec objective = environment__.response(trial);
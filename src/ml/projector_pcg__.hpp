@@ -22,6 +22,7 @@ class Projector<C,PCG,D>
 		const uword max_trials__;
 		const uword n_line_steps__;
 		const uword n_literals__;
+		Philox generator__;
 
 	public:
 		// Constructors & Destructor
@@ -33,7 +34,8 @@ class Projector<C,PCG,D>
 			regularizer__(regularizer),
 			max_trials__(max_trials),
 			n_line_steps__(n_line_steps),
-			n_literals__(circuit.n_literals())
+			n_literals__(circuit.n_literals()),
+			generator__(Philox::stream())
 		{
 		}
 
@@ -102,6 +104,9 @@ class Projector<C,PCG,D>
 			assignments.col(0) = point;
 			distribution[0] = 1.0;
 
+			// One objective per iteration: each gradient depends on the point
+			// moved by the previous step, so the batched minimizer has nothing
+			// to share here
 			Minimizer<C> minimizer(circuit__);
 
 			//cout << io::info("Projection") << endl;
@@ -133,10 +138,8 @@ class Projector<C,PCG,D>
 		// Sample from Bregman decomposition
 		inline dvec sample(const dvec& distribution, const dmat& assignments)
 		{
-			std::random_device rd;
-			mte generator(rd());
 			std::discrete_distribution<int> discrete(distribution.begin(),distribution.end());
-			uword index = (uword) discrete(generator);
+			uword index = (uword) discrete(generator__);
 			return assignments.col(index);
 		}
 
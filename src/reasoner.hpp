@@ -14,6 +14,7 @@ template<circuit_t C> class Circuit;
 template<circuit_t C> class Counter;
 template<circuit_t C> class Counter__;
 template<circuit_t C, query_t Q> class Engine__;
+template<circuit_t C> class Enumerator;
 template<circuit_t C, query_t Q> class Optimizer;
 template<circuit_t C, query_t Q> class Optimizer__;
 template<circuit_t C, unsigned int I> class Marginalizer;
@@ -31,6 +32,7 @@ template<circuit_t C> using Minimizer = Optimizer<C, MIN>;
 #include "ai/dnnf_sampler__.hpp"
 #include "ai/dnnf_marginalizer__.hpp"
 #include "ai/dnnf_optimizer__.hpp"
+#include "ai/dnnf_enumerator__.hpp"
 // #include "ai/dnnf_estimator_bivariate__.hpp"
 // #include "ai/sdd_circuit__.hpp"
 // #include "ai/sdd_counter_.hpp"
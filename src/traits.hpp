@@ -114,11 +114,13 @@ namespace traits
 {
 	using co = std::integral_constant<query_t, CO>;
 	using ct = std::integral_constant<query_t, CT>;
+	using lct = std::integral_constant<query_t, LCT>;
 	using max = std::integral_constant<query_t, MAX>;
 	using min = std::integral_constant<query_t, MIN>;
 
 	template<query_t Q> struct to_query : public co {};
 	template<> struct to_query<CT>: public ct {};
+	template<> struct to_query<LCT>: public lct {};
 	template<> struct to_query<MAX>: public max {};
 	template<> struct to_query<MIN>: public min {};
 
@@ -14,9 +14,17 @@
 
 // STD Library
 #include <algorithm>
+#include <atomic>
+#include <bitset>
 #include <cassert>
 #include <chrono>
+#include <climits>
 #include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <future>
@@ -24,9 +32,12 @@
 #include <iostream>
 #include <iterator>
 #include <list>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <numeric>
+#include <queue>
 #include <random>
-#include <regex>
 #include <sstream>
 #include <stack>
 #include <stdexcept>
@@ -35,11 +46,17 @@
 #include <unordered_map>
 #include <vector>
 
+// POSIX Library
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 // Boost Library
 // #include <boost/math/constants/constants.hpp>
 // #include <boost/math/distributions/binomial.hpp>
 // #include <boost/multiprecision/cpp_int.hpp>
-// #include <boost/multiprecision/gmp.hpp>
+#include <boost/multiprecision/gmp.hpp>
 // #include <boost/random/mersenne_twister.hpp>
 // #include <boost/random/uniform_int_distribution.hpp>
 
@@ -59,7 +76,7 @@
 
 using sword = arma::sword;
 using uword = arma::uword;
-// using mpi = boost::multiprecision::mpz_int;
+using mpi = boost::multiprecision::mpz_int;
 // using mpr = boost::multiprecision::mpq_rational;
 
 // using mpf50 = boost::multiprecision::mpf_float_50;